@@ -1,2 +1,3 @@
 from dhs import *
-from .sample import *
\ No newline at end of file
+from .sample import *
+from .aio import *
\ No newline at end of file
@@ -0,0 +1,15 @@
+import asyncio
+
+__all__ = ['run_async', 'shortest_async']
+
+
+def run_async(net, o, d):
+    """ Awaitable hyperpath of Network net from o to d, (edge_idx, prob, cost)
+    The search runs on the network's worker threads, the event loop only
+    wakes up to collect the answer."""
+    return asyncio.wrap_future(net.submit_run(o, d))
+
+
+def shortest_async(net, o):
+    """ Awaitable shortest distances of Network net from o to every vertex"""
+    return asyncio.wrap_future(net.submit_shortest(o))
@@ -7,22 +7,79 @@
 
 #ifndef ALGORITHM_H
 #define ALGORITHM_H
-#include <sys/timeb.h>
 
+#include <chrono>
+#include <cstdint>
+
+// ns of a monotonic clock
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// what searches did and where their time went, summed over searches. A
+// label setting pass ends either because no key left can improve the origin
+// (stopped_at_origin) or because the heap ran empty (exhausted); a single
+// search counts one of the two.
+struct SearchStats {
+    int64_t searches;
+    int64_t search_ns; // label setting: the backward pass of a hyperpath, Dijkstra
+    int64_t sort_ns; // ordering the attractive edges for loading
+    int64_t load_ns; // forward pass
+    int64_t output_ns; // copying the results out
+    int64_t vertices_scanned; // vertices whose edges were relaxed
+    int64_t edges_scanned;
+    int64_t inserts;
+    int64_t decrease_keys;
+    int64_t delete_mins;
+    int64_t comparisons; // heap key comparisons, as far as the heap counts them
+    int64_t stopped_at_origin;
+    int64_t exhausted;
+
+    SearchStats() { clear(); }
+
+    void clear() {
+        searches = search_ns = sort_ns = load_ns = output_ns = 0;
+        vertices_scanned = edges_scanned = 0;
+        inserts = decrease_keys = delete_mins = comparisons = 0;
+        stopped_at_origin = exhausted = 0;
+    }
+
+    void add(const SearchStats &_s) {
+        searches += _s.searches;
+        search_ns += _s.search_ns;
+        sort_ns += _s.sort_ns;
+        load_ns += _s.load_ns;
+        output_ns += _s.output_ns;
+        vertices_scanned += _s.vertices_scanned;
+        edges_scanned += _s.edges_scanned;
+        inserts += _s.inserts;
+        decrease_keys += _s.decrease_keys;
+        delete_mins += _s.delete_mins;
+        comparisons += _s.comparisons;
+        stopped_at_origin += _s.stopped_at_origin;
+        exhausted += _s.exhausted;
+    }
+};
+
+// base of the engines: the stats of the last call that searched, batches
+// summed over their searches, and their running total
 class Algorithm {
-private:
-    
-    int start_ms;
-    
-    int get_now_ms() const;
-    
+protected:
+    SearchStats stats;
+
+    SearchStats total;
+
+    // ends a call: _s becomes the last stats and is added to the total
+    void record(const SearchStats &_s);
+
 public:
-    
-    Algorithm();
-    
-    ~Algorithm();
-    
-    int get_elapesd_ms() const;
+
+    const SearchStats& get_stats() const;
+
+    const SearchStats& get_total_stats() const;
+
+    void reset_stats();
 };
 
 #endif /* ALGORITHM_H_ */
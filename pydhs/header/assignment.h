@@ -0,0 +1,82 @@
+//
+//  assignment.h
+//  MyGraph
+//
+//  Hyperpath based network loading of OD demand.
+//
+
+#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+#include <memory>
+#include <vector>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include "graph.h"
+#include "hyperpath.h"
+
+using namespace std;
+namespace bp = boost::python;
+namespace np = boost::python::numpy;
+
+// OD demand grouped by destination: the origins and volumes towards
+// d_idx[k] are o_idx/volume[offset[k]..offset[k+1])
+struct Demand {
+    vector<int> d_idx;
+    vector<size_t> offset;
+    vector<int> o_idx;
+    vector<float> volume;
+};
+
+Demand group_demand(const vector<int> &_o_idx, const vector<int> &_d_idx,
+                    const vector<float> &_volume);
+
+// loads demand onto edges, one backward and one forward pass per
+// destination, with destinations spread over worker threads. The workspaces
+// and flow buffers are kept, so repeated loads don't reallocate.
+class NetworkLoader {
+public:
+    NetworkLoader(const Topology &_t, int _threads, size_t _tasks);
+
+    void load(const HyperpathWeights &_w, const Demand &_demand, vector<double> &_flow);
+
+    // the searches of every load so far, over all workers
+    SearchStats get_stats() const;
+
+private:
+    const Topology &t;
+    int workers;
+    vector<unique_ptr<HyperpathWorkspace> > spaces;
+    vector<vector<double> > flows; // per worker
+};
+
+// volume-delay function t0 * (1 + alpha * (x / c)^beta), c <= 0 meaning
+// uncongested
+struct BPR {
+    float alpha;
+    float beta;
+    void apply(const vector<float> &_t0, const vector<float> &_capacity,
+               const vector<double> &_flow, vector<float> &_t) const;
+};
+
+// method of successive averages between loading and the volume-delay
+// update of wmin and wmax. When _flow is non-empty it is the average of
+// _iteration earlier loads to continue from. It receives the final flows,
+// _gaps the relative flow gap of every iteration and _stats the searches of
+// all loads; returns the iteration count reached.
+int equilibrium(const Topology &_t, const vector<float> &_wmin0, const vector<float> &_wmax0,
+                const vector<float> &_capacity, const Demand &_demand, const BPR &_bpr,
+                int _max_iter, double _tol, int _threads, int _iteration,
+                vector<double> &_flow, vector<float> &_wmin, vector<float> &_wmax,
+                vector<double> &_gaps, SearchStats &_stats);
+
+// python entry: od rows are (origin, destination, volume)
+np::ndarray load_demand(Graph* _g, const bp::object &_wmin, const bp::object &_wmax,
+                        const bp::object &_od, int _threads);
+
+bp::dict assign_equilibrium(Graph* _g, const bp::object &_wmin, const bp::object &_wmax,
+                            const bp::object &_capacity, const bp::object &_od,
+                            float _alpha, float _beta, int _max_iter, double _tol,
+                            int _threads, const bp::object &_flow, int _iteration);
+
+#endif /* ASSIGNMENT_H */
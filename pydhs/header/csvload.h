@@ -0,0 +1,41 @@
+//
+//  csvload.h
+//  MyGraph
+//
+//  Edge lists from delimited text files. The file is memory mapped and cut
+//  into chunks at line ends, which are parsed in parallel; only the graph
+//  is then built on one thread.
+//
+
+#ifndef CSVLOAD_H
+#define CSVLOAD_H
+
+#include <string>
+#include <vector>
+#include "graph.h"
+
+using namespace std;
+
+// the columns of eid, fvid and tvid followed by the weight columns, by
+// index or, when name is set, by header name
+struct CsvColumns {
+    vector<int> index;
+    vector<string> name;
+};
+
+// a graph of the rows of _path and one weight array per weight column, by
+// edge idx. _header is 1 when the first line is a header, 0 when it isn't
+// and -1 to take it as one when its weight fields aren't numbers. Empty
+// columns take the three id columns and every column after them. Fields
+// aren't quoted. Throws a string naming the line of a malformed row.
+Graph* load_csv_graph(const string &_path, const CsvColumns &_columns, int _header,
+                      char _delimiter, int _threads, vector<vector<float> > &_weights);
+
+// a table of a key column and numeric columns, as time-of-day profiles are
+// kept: _header receives the header fields after the first, _keys the first
+// field of every other line and _values their numbers, row by row. Every
+// row has as many fields as the header.
+void load_csv_table(const string &_path, char _delimiter, int _threads, vector<string> &_header,
+                    vector<string> &_keys, vector<float> &_values);
+
+#endif /* CSVLOAD_H */
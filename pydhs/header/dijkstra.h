@@ -12,8 +12,10 @@
 #include <limits>
 #include <string>
 #include "algorithm.h"
+#include "dijkstra_search.h"
 #include "graph.h"
 #include "radixheap.h"
+#include "profile.h"
 #include <boost/python/numpy.hpp>
 namespace bp = boost::python;
 class Dijkstra :
@@ -33,6 +35,31 @@ private:
     
     float* weights;
     
+    // edge labels, used instead of the vertex ones when the graph has turn
+    // tables: u_e is the cost of arriving at the head of an edge
+    bool edge_based;
+    
+    float* u_e;
+    
+    int* pre_e; // edge turned from, -1 at the origin
+    
+    bool* open_e;
+    
+    bool* close_e;
+    
+    int* last_e; // cheapest edge into each vertex
+    
+    void run_edges(int _o_idx);
+    
+    DijkstraLabels labels(); // the vertex labels above
+    
+    TimeProfile* profile; // time dependent weights of run_at
+    
+    bool reverse; // distances to the root over the reverse view
+    
+    // the topology searched, the reverse view in reverse mode
+    Topology topology();
+    
 public:
     
     // or const & here: passing by reference or passing a pointer
@@ -46,9 +73,17 @@ public:
 
     void run(string _oid);
     
+    void set_profile(const bp::object& _weight, float _t0, float _bin_width, bool _linear);
+    
+    void run_at(string _oid, float _time);
+    
     bp::list get_potentials();
 
     bp::list get_path(string _oid, string _did);
     
+    void set_reverse(bool _reverse);
+    
+    bool get_reverse() const;
+    
 };
 #endif /* DIJKSTRA_H_ */
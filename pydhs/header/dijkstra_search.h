@@ -0,0 +1,36 @@
+//
+//  dijkstra_search.h
+//  MyGraph
+//
+//  The vertex labelling search of Dijkstra on a Topology, free of python so
+//  that native tools can link it.
+//
+
+#ifndef DIJKSTRA_SEARCH_H
+#define DIJKSTRA_SEARCH_H
+
+#include <cstddef>
+#include "algorithm.h"
+#include "graph.h"
+#include "heap.h"
+
+using namespace std;
+
+// vertex labels of a search, n each, owned by the caller
+struct DijkstraLabels {
+    float* u;
+    int* pre_idx;
+    bool* open;
+    bool* close;
+    int* last_e; // cheapest edge into each vertex, of edge labelled searches
+};
+
+// resets the labels of _n vertices for the next search
+void dijkstra_recover(size_t _n, const DijkstraLabels &_l);
+
+// shortest distances from _o_idx over the out-edges of _t, into labels reset
+// by dijkstra_recover, with _heap holding up to n vertices. Adds to _s.
+void dijkstra_search(const Topology &_t, const float* _weights, int _o_idx, Heap &_heap,
+                     const DijkstraLabels &_l, SearchStats &_s);
+
+#endif /* DIJKSTRA_SEARCH_H */
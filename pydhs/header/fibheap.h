@@ -68,6 +68,7 @@ public:
     
     double nComps() const { return compCount; }
     void dump() const;
+    void clear();
     
 private:
     FHeapNode **trees;
@@ -76,6 +77,7 @@ private:
     double compCount;
     
     void meld(FHeapNode *treeList);
+    void freeNodes(FHeapNode *treeList);
     static void dumpNodes(FHeapNode *node, int level);
 };
 
@@ -8,6 +8,9 @@ constexpr auto MAX_IN_DEGREE = 20;
 #include <vector>
 #include <unordered_map>
 #include <set>
+#include <limits>
+#include <memory>
+#include <algorithm>
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 #include <exception>
@@ -79,29 +82,203 @@ struct Edge {
     }
 };
 
+// a turn from edge from_idx into edge to_idx at their common vertex. Turns
+// that aren't listed are free, a restriction has an infinite penalty.
+struct Turn {
+    int from_idx;
+    int to_idx;
+    float penalty;
+};
+
+// compressed sparse row arrays of a graph, indexed by vertex and edge idx.
+// Edges keep the order of Vertex::in_edges/out_edges. The arrays are only
+// read by the searches, so a Topology can be shared between threads.
+struct Topology {
+    int n;
+    int m;
+    const int* out_offset; // out_edges of vertex v are out_edge[out_offset[v]..out_offset[v+1])
+    const int* out_edge;
+    const int* in_offset;
+    const int* in_edge;
+    const int* tail; // from vertex of each edge
+    const int* head; // to vertex of each edge
+    const Turn* turns; // sorted by (from_idx, to_idx)
+    int turn_cnt;
+};
+
+// index of the turn from edge _from into edge _to in _t.turns, -1 for a free
+// turn
+inline int find_turn(const Topology &_t, int _from, int _to) {
+    int lo = 0;
+    int hi = _t.turn_cnt;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        const Turn &x = _t.turns[mid];
+        if (x.from_idx < _from || (x.from_idx == _from && x.to_idx < _to))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < _t.turn_cnt && _t.turns[lo].from_idx == _from && _t.turns[lo].to_idx == _to)
+        return lo;
+    return -1;
+}
+
+// the same topology with every edge turned round, for searching in the
+// opposite direction: out and in lists, tail and head swap places. Nothing
+// is copied and the edge and vertex indices stay the same. Turn tables are
+// left out, the engines refuse to search them reversed.
+inline Topology reverse_view(const Topology &_t) {
+    Topology r = _t;
+    r.out_offset = _t.in_offset;
+    r.out_edge = _t.in_edge;
+    r.in_offset = _t.out_offset;
+    r.in_edge = _t.out_edge;
+    r.tail = _t.head;
+    r.head = _t.tail;
+    r.turns = nullptr;
+    r.turn_cnt = 0;
+    return r;
+}
+
+// read-only graph data kept outside a Graph, e.g. in shared memory. A Graph
+// built on a store has no Vertex and Edge objects, only ids and topology.
+class GraphStore {
+public:
+    virtual ~GraphStore() {}
+    virtual const Topology& get_topology() const = 0;
+    // idx of an id, -1 when there is none
+    virtual int find_vertex(const string &_id) const = 0;
+    virtual int find_edge(const string &_id) const = 0;
+    virtual string get_vertex_id(int _idx) const = 0;
+    virtual string get_edge_id(int _idx) const = 0;
+};
+
 class Graph {
 private:
-    set<string> vertex_ids;
-    set<string> edge_ids;
     Vertex** vertices;
     Edge** edges;
     std::unordered_map<string, int> vid_to_idx;
     std::unordered_map<string, int> eid_to_idx;
     int m_cnt;
     int n_cnt;
+    
+    // backing arrays of the topology, rebuilt when edges have been added
+    vector<int> csr_out_offset;
+    vector<int> csr_out_edge;
+    vector<int> csr_in_offset;
+    vector<int> csr_in_edge;
+    vector<int> csr_tail;
+    vector<int> csr_head;
+    Topology topology;
+    
+    vector<Turn> turn_list; // turn tables, sorted lazily
+    bool turns_sorted;
+    
+    std::shared_ptr<const GraphStore> store; // set for a read-only graph
+    
+    void check_writable() const {
+        if (store)
+            throw string("ERROR: graph is read-only");
+    }
+    
+    // the vertex of _id, added when there is none; one hash lookup either way
+    Vertex* vertex_for(const string &_id) {
+        auto ins = vid_to_idx.insert(make_pair(_id, n_cnt));
+        if (!ins.second)
+            return vertices[ins.first->second];
+        Vertex* v = new Vertex(_id);
+        vertices[n_cnt] = v;
+        v->idx = n_cnt;
+        n_cnt++;
+        return v;
+    }
+    
+    void check_objects() const {
+        if (store)
+            throw string("ERROR: a shared graph has no vertex and edge objects, use ids");
+    }
+    
+    // sorts the turns by (from, to), the one added last winning among
+    // duplicates
+    void sort_turns() {
+        stable_sort(turn_list.begin(), turn_list.end(), [](const Turn &a, const Turn &b) {
+            return a.from_idx < b.from_idx || (a.from_idx == b.from_idx && a.to_idx < b.to_idx);
+        });
+        size_t k = 0;
+        for (size_t i = 0; i < turn_list.size(); ++i) {
+            if (k > 0 && turn_list[k - 1].from_idx == turn_list[i].from_idx
+                    && turn_list[k - 1].to_idx == turn_list[i].to_idx)
+                turn_list[k - 1] = turn_list[i];
+            else
+                turn_list[k++] = turn_list[i];
+        }
+        turn_list.resize(k);
+        topology.turns = turn_list.data();
+        topology.turn_cnt = int(turn_list.size());
+        turns_sorted = true;
+    }
+    
+    void build_topology() {
+        csr_out_offset.assign(n_cnt + 1, 0);
+        csr_in_offset.assign(n_cnt + 1, 0);
+        csr_out_edge.clear();
+        csr_in_edge.clear();
+        for (int i = 0; i < n_cnt; ++i) {
+            for (const auto &e : vertices[i]->out_edges)
+                csr_out_edge.push_back(e->idx);
+            for (const auto &e : vertices[i]->in_edges)
+                csr_in_edge.push_back(e->idx);
+            csr_out_offset[i + 1] = csr_out_edge.size();
+            csr_in_offset[i + 1] = csr_in_edge.size();
+        }
+        csr_tail.resize(m_cnt);
+        csr_head.resize(m_cnt);
+        for (int i = 0; i < m_cnt; ++i) {
+            csr_tail[i] = edges[i]->from_vertex->idx;
+            csr_head[i] = edges[i]->to_vertex->idx;
+        }
+        topology.n = n_cnt;
+        topology.m = m_cnt;
+        topology.out_offset = csr_out_offset.data();
+        topology.out_edge = csr_out_edge.data();
+        topology.in_offset = csr_in_offset.data();
+        topology.in_edge = csr_in_edge.data();
+        topology.tail = csr_tail.data();
+        topology.head = csr_head.data();
+    }
 public:
     Graph(int n, int m) {
         m_cnt = 0;
         n_cnt = 0;
         vertices = new Vertex*[n];
         edges = new Edge*[m];
+        vid_to_idx.reserve(n);
+        eid_to_idx.reserve(m);
+        topology.n = -1;
+        topology.m = -1;
+        topology.turns = nullptr;
+        topology.turn_cnt = 0;
+        turns_sorted = true;
+    }
+    
+    // a read-only graph over _store, nothing is copied
+    explicit Graph(const std::shared_ptr<const GraphStore> &_store) : store(_store) {
+        vertices = nullptr;
+        edges = nullptr;
+        topology = _store->get_topology();
+        n_cnt = topology.n;
+        m_cnt = topology.m;
+        turns_sorted = true;
     }
     
     ~Graph() {
-        for (int i = 0; i < n_cnt; ++i)
-            delete vertices[i];
-        for (int i = 0; i < m_cnt; ++i)
-            delete edges[i];
+        if (!store) {
+            for (int i = 0; i < n_cnt; ++i)
+                delete vertices[i];
+            for (int i = 0; i < m_cnt; ++i)
+                delete edges[i];
+        }
         delete[] vertices;
         vertices = nullptr;
         delete[] edges;
@@ -113,8 +290,9 @@ public:
         size_t n = get_vertex_number();
         //    Graph* gr = new Graph(int(n), int(m));
         boost::shared_ptr<Graph> gr (boost::make_shared<Graph>(n, m));
+        const Topology &t = get_topology();
         for (unsigned int i = 0; i< m; ++i){
-            gr->add_edge(get_edge(i)->id, get_edge(i)->to_vertex->id,get_edge(i)->from_vertex->id);
+            gr->add_edge(get_eid(i), get_vid(t.head[i]), get_vid(t.tail[i]));
         }
         return gr;
     }
@@ -127,38 +305,65 @@ public:
         return edges;
     }
     
+    // not thread-safe while edges are being added; call it before handing the
+    // topology to search threads
+    const Topology& get_topology() {
+        if (topology.n != n_cnt || topology.m != m_cnt)
+            build_topology();
+        if (!turns_sorted)
+            sort_turns();
+        return topology;
+    }
+    
     
     
     int get_vidx(const string &_vid) {
+        if (store) {
+            int idx = store->find_vertex(_vid);
+            if (idx < 0)
+                throw "ERROR: vertex not exist: " + _vid;
+            return idx;
+        }
         if (vid_to_idx.find(_vid) == vid_to_idx.end())
             throw "ERROR: vertex not exist: " + _vid;
         return vid_to_idx[_vid];
     }
     
     int get_eidx(const string &_eid) {
-        if (eid_to_idx.find(_eid) == vid_to_idx.end())
+        int idx = find_eidx(_eid);
+        if (idx < 0)
             throw "ERROR: edge not exist: " + _eid;
-        return eid_to_idx[_eid];
+        return idx;
+    }
+    
+    // idx of an edge id, -1 when there is no such edge
+    int find_eidx(const string &_eid) const {
+        if (store)
+            return store->find_edge(_eid);
+        auto it = eid_to_idx.find(_eid);
+        return it == eid_to_idx.end() ? -1 : it->second;
+    }
+    
+    // ids by idx, for graphs with or without vertex and edge objects
+    string get_vid(int _idx) const {
+        return store ? store->get_vertex_id(_idx) : vertices[_idx]->id;
+    }
+    
+    string get_eid(int _idx) const {
+        return store ? store->get_edge_id(_idx) : edges[_idx]->id;
     }
     
     // build graph methods
     
     void add_vertex(const string &_id) {
-        if (vertex_ids.find(_id) == vertex_ids.end()) // do insertion only when the vertex hasn't been inserted
-        {
-            vertex_ids.insert(_id);
-            Vertex* v = new Vertex(_id);
-            vertices[n_cnt] = v;
-            vid_to_idx[_id] = n_cnt;
-            v->idx = n_cnt;
-            n_cnt++;
-        }
+        check_writable();
+        vertex_for(_id);
     }
     
     void add_edge(const string &_id, Vertex* _fv, Vertex* _tv) {
-        if (edge_ids.find(_id) == edge_ids.end()) // do insertion only when the edge hasn't been inserted
+        check_writable();
+        if (eid_to_idx.insert(make_pair(_id, m_cnt)).second) // do insertion only when the edge hasn't been inserted
         {
-            edge_ids.insert(_id);
             Edge* e = new Edge(_id, _fv, _tv);
             edges[m_cnt] = e;
             //        _fv->out_edges[_fv->out_cnt] = e;
@@ -167,20 +372,17 @@ public:
             //		_tv->in_edges[_tv->in_cnt] = e;
             _tv->in_edges.push_back(e); //has to be used together to ensure efficiency
             _tv->in_cnt++;
-            eid_to_idx[_id] = m_cnt;
             e->idx = m_cnt;
             m_cnt++;
         }
     }
     
     void add_edge(const string &_id, const string &_fv_id, const string &_tv_id) {
-        if (edge_ids.find(_id) == edge_ids.end()) // do insertion only when the edge hasn't been inserted
+        check_writable();
+        if (eid_to_idx.insert(make_pair(_id, m_cnt)).second) // do insertion only when the edge hasn't been inserted
         {
-            edge_ids.insert(_id);
-            add_vertex(_fv_id);
-            add_vertex(_tv_id);
-            auto fv = get_vertex(_fv_id);
-            auto tv = get_vertex(_tv_id);
+            auto fv = vertex_for(_fv_id);
+            auto tv = vertex_for(_tv_id);
             Edge* e = new Edge(_id, fv, tv);
             
             edges[m_cnt] = e;
@@ -192,19 +394,56 @@ public:
             //		_tv->in_edges[_tv->in_cnt] = e;
             tv->in_edges.push_back(e); //has to be used together to ensure efficiency
             tv->in_cnt++;
-            eid_to_idx[_id] = m_cnt;
             e->idx = m_cnt;
             m_cnt++;
         }
     }
     
+    // turn table methods
+    
+    // penalty for turning from edge _from_eid into _to_eid, replacing an
+    // earlier entry of the same turn
+    void add_turn(const string &_from_eid, const string &_to_eid, float _penalty) {
+        check_writable();
+        int from_idx = get_eidx(_from_eid);
+        int to_idx = get_eidx(_to_eid);
+        if (edges[from_idx]->to_vertex != edges[to_idx]->from_vertex)
+            throw "ERROR: edges not adjacent: " + _from_eid + ", " + _to_eid;
+        if (!(_penalty >= 0))
+            throw "ERROR: negative turn penalty: " + _from_eid + ", " + _to_eid;
+        Turn t;
+        t.from_idx = from_idx;
+        t.to_idx = to_idx;
+        t.penalty = _penalty;
+        turn_list.push_back(t);
+        turns_sorted = false;
+    }
+    
+    void add_turn_restriction(const string &_from_eid, const string &_to_eid) {
+        add_turn(_from_eid, _to_eid, numeric_limits<float>::infinity());
+    }
+    
+    void clear_turns() {
+        check_writable();
+        turn_list.clear();
+        turns_sorted = false;
+    }
+    
+    inline size_t get_turn_number() {
+        if (!turns_sorted)
+            sort_turns();
+        return topology.turn_cnt;
+    }
+    
     // get vertex methods
     inline Vertex* get_vertex (const string &_id) const{
+        check_objects();
         int idx = vid_to_idx.at(_id);
         return vertices[idx];
     }
     
     inline Vertex* get_vertex(int _idx) const{
+        check_objects();
         return vertices[_idx];
     }
     
@@ -224,6 +463,7 @@ public:
     
     // get edge methods
     inline Edge* get_edge(string _id) const{
+        check_objects();
         int idx = eid_to_idx.at(_id);
         return edges[idx];
     }
@@ -243,6 +483,7 @@ public:
     }
     
     inline Edge* get_edge (int _idx) const{
+        check_objects();
         return edges[_idx];
     }
     
@@ -14,27 +14,65 @@
 #include <string>
 #include "algorithm.h"
 #include "graph.h"
+#include "potential.h"
+#include "profile.h"
+#include "fibheap.h"
+#include "hyperpath_search.h"
+#include <memory>
 #include <unordered_map>
 #include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
 using namespace std;
 namespace bp = boost::python;
+namespace np = boost::python::numpy;
+
 class Hyperpath: public Algorithm {
 private:
     Graph *g;
-    float *u_i; // node labels
-    float* f_i; // weight sum
-    float* p_i;
     
     float* wmin;
     float* wmax;
     float* h;
+    unsigned long weight_version; // bumped by set_weights, keys the potential cache
+    PotentialCache* potentials; // exact potentials, replaces h when set
+    TimeProfile* profile_min; // time dependent wmin/wmax of run_at
+    TimeProfile* profile_max;
 
-    float* u_a;
-    float* p_a; // edge choice possiblities
-    bool* open;
-    bool* close;
-    vector<pair<string, float> > hyperpath;
+    HyperpathWorkspace* ws;
+    unordered_map<int, shared_ptr<const HyperpathTree> > trees; // by destination
+    int hyperpath_o_idx;
+    float hyperpath_cost; // expected cost u_i[o] of the origin
+    float hyperpath_bound; // how far hyperpath_cost may exceed the exact one
+    HyperpathPruning pruning;
+    bool reverse; // search the reverse view of the graph
+    float gev_theta; // scale of the GEV probabilities, 0 for Ma2013 ones
+    vector<int> hyperpath_edges; // edge idx of the last hyperpath
+    vector<float> hyperpath_probs; // and their choice possibilities
     vector<string> path_rec;
+
+    // weights of a query from _o_idx; _cached keeps the potentials alive
+    HyperpathWeights get_weights(const Topology &_t, int _o_idx,
+                                 PotentialCache::Potentials &_cached);
+
+    // copies the hyperpath left in ws, in the order of _po_edges
+    void collect(const vector<int> &_po_edges, int _o_idx, float _cost);
+
+    // hyperpath_gev with a GEV scale set, hyperpath_search otherwise
+    void search(const Topology &_t, const HyperpathWeights &_w, int _o_idx, int _d_idx,
+                HyperpathWorkspace &_ws, const HyperpathPruning* _prune) const;
+
+    // the topology searched, the reverse view in reverse mode
+    Topology topology() const;
+
+    // full backward pass for _d_idx into trees, adding to ws->stats
+    void build_tree(int _d_idx);
+
+    // the labels kept for trees, and the per vertex tables of sampling, know
+    // nothing of turns; _what names the refused feature
+    void check_no_turns(const Topology &_t, const char* _what = "trees") const;
+
+    // the pruning of searches, nullptr in exact mode
+    const HyperpathPruning* get_pruning(const Topology &_t) const;
     
 public:
     
@@ -46,10 +84,50 @@ public:
 
     void set_potentials(const bp::object &h);
 
+    void cache_potentials(int capacity);
+
     bp::list get_hyperpath();
+
+    np::ndarray get_edges() const;
+
+    np::ndarray get_probs() const;
+
+    float get_cost() const;
+
+    float get_error_bound() const;
+
+    void set_approximation(float _eps, int _k);
+
+    void set_gev(float _theta);
+
+    bp::tuple get_node_probs() const;
     
     void run(const string& _oid, const string& _did);
 
+    void set_profile(const bp::object &_wmin, const bp::object &_wmax,
+                     float _t0, float _bin_width, bool _linear);
+
+    void run_at(const string& _oid, const string& _did, float _time);
+
+    bp::tuple sample_routes(const string& _oid, const string& _did, int _k, unsigned long _seed);
+
+    bp::tuple run_many(const bp::object &_oids, const bp::object &_dids, int _threads);
+
+    void run_tree(const string& _did);
+
+    void load(const string& _oid, const string& _did);
+
+    int update_weights(const bp::object &_edges, const bp::object &_wmin,
+                       const bp::object &_wmax);
+
+    np::ndarray get_tree_costs(const string& _did);
+
+    void set_reverse(bool _reverse);
+
+    bool get_reverse() const;
+
+    void clear_trees();
+
     void recover();
 };
 
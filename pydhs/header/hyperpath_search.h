@@ -0,0 +1,126 @@
+//
+//  hyperpath_search.h
+//  MyGraph
+//
+//  The hyperpath searches on a Topology, free of python so that native
+//  tools can link them.
+//
+
+#ifndef HYPERPATH_SEARCH_H
+#define HYPERPATH_SEARCH_H
+
+#include <limits>
+#include <vector>
+#include "algorithm.h"
+#include "graph.h"
+#include "fibheap.h"
+
+using namespace std;
+
+// weights read by a search, shared by all workers of a batch
+struct HyperpathWeights {
+    const float* wmin;
+    const float* wmax;
+    const float* h; // node potentials, nullptr for none
+};
+
+// approximate search: an edge is left out of the choice set of its tail when
+// its share f_a / f_i would fall below eps on acceptance, or when the set
+// already holds k edges. Zero switches a rule off.
+struct HyperpathPruning {
+    float eps;
+    int k;
+};
+
+// labels of a single hyperpath search. Every worker of a batch owns one, so
+// concurrent searches only share the immutable Topology and weights.
+// With turn tables the heap items are the m edges followed by the turns.
+class HyperpathWorkspace {
+public:
+    HyperpathWorkspace(size_t n, size_t m, size_t turns = 0);
+
+    // resets the labels touched by the last search
+    void recover();
+
+    vector<float> u_i; // node labels
+    vector<float> f_i; // weight sum
+    vector<float> p_i;
+    vector<float> u_e; // labels after arriving over an edge, with turn tables
+    vector<float> f_e;
+    vector<float> u_a;
+    vector<float> p_a; // edge choice possiblities
+    vector<char> open;
+    vector<char> close;
+    vector<int> po_edges; // attractive edges, p_a is zero for the unused ones
+    vector<int> po_from; // with turn tables, the edge turned from, -1 at the tail
+    vector<int> touched_vertices;
+    vector<int> touched_edges;
+    FHeap heap;
+    vector<float> v_i; // unpruned labels over the pruned ones, sized on first use
+    vector<float> g_i;
+    vector<int> k_i; // choice set sizes
+    vector<float> m_i; // least cost + W_j of the GEV sums, sized on first use
+    vector<float> s_i; // GEV sums scaled by exp(theta * m_i)
+    float bound; // error bound of u_i[o] left by the last pruned search
+    SearchStats stats; // added to by every search, cleared by the owner only
+};
+
+// labels of a backward pass run to completion from a destination. They
+// don't depend on the origin, so one tree serves the forward pass of any
+// origin, e.g. a vehicle re-querying from its current vertex.
+struct HyperpathTree {
+    int d_idx;
+    vector<float> u_i; // node labels
+    vector<float> f_i; // weight sum
+    vector<int> po_edges; // attractive edges in loading order
+};
+
+// backward and forward pass of Ma et al. 2013 from _o_idx to _d_idx. Turn
+// tables of _t are honoured by labelling the edges instead of the vertices,
+// a listed turn joining the heap with its penalty added to the key; po_edges
+// then ends up holding every loaded edge once.
+// With _prune the choice sets are cut as described there, the loading
+// renormalised over what is left and _ws.bound set such that u_i[o]
+// overestimates the exact expected cost by at most that much. Pruning isn't
+// applied with turn tables.
+void hyperpath_search(const Topology &_t, const HyperpathWeights &_w,
+                      int _o_idx, int _d_idx, HyperpathWorkspace &_ws,
+                      const HyperpathPruning* _prune = nullptr);
+
+// hyperpath based network GEV: the backward pass finds the attractive edges
+// as hyperpath_search, then with the mean edge cost c_a = (wmin + wmax) / 2
+//   W_i = -1/theta ln sum_a f_a / f_i exp(-theta (c_a + W_j)),  W_d = 0
+// is taken over them, heads before tails. The forward pass splits p_i by
+//   P(a|i) = f_a / f_i exp(-theta (c_a + W_j - W_i)),
+// which tends to the hyperpath possibilities as theta goes to 0 and to the
+// cheapest attractive edges as it grows. W_o is left in u_i[o]. Turn tables
+// aren't supported.
+void hyperpath_gev(const Topology &_t, const HyperpathWeights &_w, float _theta,
+                   int _o_idx, int _d_idx, HyperpathWorkspace &_ws);
+
+// backward pass to every vertex that reaches _d_idx, without potentials;
+// _ws is only used as scratch space. Turn tables aren't supported.
+void hyperpath_tree(const Topology &_t, const HyperpathWeights &_w,
+                    int _d_idx, HyperpathWorkspace &_ws, HyperpathTree &_tree);
+
+// brings _tree up to date after the wmin/wmax of _edges changed, _old_wmin
+// holding their wmin before. Only the labels above the cheapest change are
+// recomputed. Returns false, leaving _repaired untouched, when the changes
+// can't alter the tree.
+bool hyperpath_repair(const Topology &_t, const HyperpathWeights &_w,
+                      const vector<int> &_edges, const vector<float> &_old_wmin,
+                      const HyperpathTree &_tree, HyperpathWorkspace &_ws,
+                      HyperpathTree &_repaired);
+
+// forward pass from _o_idx over _tree, leaving p_i and p_a in _ws
+void hyperpath_load(const Topology &_t, const HyperpathWeights &_w,
+                    const HyperpathTree &_tree, int _o_idx, HyperpathWorkspace &_ws);
+
+// full backward pass from _d_idx, then one forward pass carrying _volume[k]
+// units from every origin _o_idx[k]; p_a in _ws holds the edge flows. Turn
+// tables are honoured as by hyperpath_search.
+void hyperpath_demand(const Topology &_t, const HyperpathWeights &_w, int _d_idx,
+                      const int* _o_idx, const float* _volume, size_t _k,
+                      HyperpathWorkspace &_ws);
+
+#endif /* HYPERPATH_SEARCH_H */
@@ -0,0 +1,72 @@
+//
+//  linkprofile.h
+//  MyGraph
+//
+//  Time-of-day weights of the edges of a graph as one dense float matrix,
+//  read from a profile csv or from a binary cache of an earlier read.
+//
+//  The matrix is [edge idx x time bin] and held bin-major: the weights of
+//  all edges in one bin are contiguous, so a bin is viewed without a copy
+//  and set_weights takes it with a single memcpy. The cache is that array behind a small header and is
+//  read back with a single read.
+//
+
+#ifndef LINKPROFILE_H
+#define LINKPROFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "graph.h"
+
+using namespace std;
+
+class LinkProfile {
+public:
+    // m edges, bins bins from _t0 on, every _bin_width seconds, all 0
+    LinkProfile(int _m, int _bins, float _t0, float _bin_width);
+
+    // the bin time _t falls in; times before _t0 are in the first bin,
+    // times after the last sample in the last one
+    int bin_at(float _t) const {
+        float x = (_t - t0) / bin_width;
+        if (!(x > 0))
+            return 0;
+        return x >= bins - 1 ? bins - 1 : int(x);
+    }
+
+    // the m weights of bin _bin, by edge idx
+    float* column(int _bin) { return &values[size_t(_bin) * m]; }
+    const float* column(int _bin) const { return &values[size_t(_bin) * m]; }
+
+    int get_m() const { return m; }
+    int get_bins() const { return bins; }
+    float get_t0() const { return t0; }
+    float get_bin_width() const { return bin_width; }
+
+    // writes the matrix for _g, stamped with the size and modification time
+    // of _source, to _cache; the file is replaced in one rename
+    void save(const Graph &_g, const string &_source, const string &_cache) const;
+
+    // the matrix of _cache when it was saved for the edge ids of _g and,
+    // when _source still exists, from _source as it is now; else null
+    static LinkProfile* load_cache(const Graph &_g, const string &_source, const string &_cache);
+
+private:
+    int m;
+    int bins;
+    float t0;
+    float bin_width;
+    vector<float> values; // bins x m
+};
+
+// the profile of _g in _path: a header of an empty field and the bin times
+// in seconds, equally spaced, then rows of an edge id and one weight per
+// bin. Rows of edges not in _g are skipped. Edges without a row take their
+// _fill weight in every bin, or are an error when _fill is null. When
+// _cache is set it is read instead of _path if it's up to date, and
+// written after reading _path otherwise.
+LinkProfile* load_link_profile(const Graph &_g, const string &_path, const string &_cache,
+                               const float* _fill, char _delimiter, int _threads);
+
+#endif /* LINKPROFILE_H */
@@ -0,0 +1,40 @@
+//
+//  matsim.h
+//  MyGraph
+//
+//  Streaming reader of MATSim network.xml files. The file is read in blocks
+//  and every <link> is handed over as soon as its tag is complete, so memory
+//  doesn't grow with the file, only with what the caller keeps.
+//
+
+#ifndef MATSIM_H
+#define MATSIM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "graph.h"
+
+using namespace std;
+
+struct MatsimLink {
+    string id;
+    string from;
+    string to;
+    float length;
+    float freespeed;
+    float capacity; // 0 when not given
+    float permlanes; // 1 when not given
+};
+
+// calls _link for every link of the network in file order; throws a string
+// when the file can't be read or a link lacks id, from, to, length or
+// freespeed
+void read_matsim_links(const string &_path, const function<void(const MatsimLink &)> &_link);
+
+// the links of a network file as a graph, in one pass; _length and
+// _freespeed receive the attributes by edge idx. A link id seen before is
+// skipped, as Graph::add_edge does.
+Graph* load_matsim_graph(const string &_path, vector<float> &_length, vector<float> &_freespeed);
+
+#endif /* MATSIM_H */
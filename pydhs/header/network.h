@@ -0,0 +1,146 @@
+//
+//  network.h
+//  MyGraph
+//
+//  Thread-safe queries: an immutable graph and weight snapshot shared by all
+//  threads, with the per query labels drawn from a pool.
+//
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include "graph.h"
+#include "hyperpath.h"
+#include "parallel.h"
+#include "potential.h"
+
+using namespace std;
+namespace bp = boost::python;
+namespace np = boost::python::numpy;
+
+// edge weights as of one point in time; never written once built
+struct WeightSnapshot {
+    vector<float> wmin;
+    vector<float> wmax;
+    unsigned long version; // keys the potential cache
+};
+
+// hands out workspaces, creating one when none is free. A workspace goes
+// back to the pool when its lease ends, so the pool grows to the number of
+// concurrent queries and no further.
+class WorkspacePool {
+public:
+    WorkspacePool(const Topology &_t);
+
+    class Lease {
+    public:
+        Lease(WorkspacePool &_pool);
+        ~Lease();
+        HyperpathWorkspace &operator*() { return *ws; }
+    private:
+        WorkspacePool &pool;
+        unique_ptr<HyperpathWorkspace> ws;
+    };
+
+    size_t size() const;
+
+private:
+    int n;
+    int m;
+    int turn_cnt;
+    size_t created;
+    vector<unique_ptr<HyperpathWorkspace> > idle;
+    mutable mutex lock;
+};
+
+// a graph and a snapshot of its weights, so any number of threads may query
+// it at once. New weights are published RCU style: update builds a new
+// snapshot and swaps it in atomically. Every query loads the pointer once and
+// keeps its snapshot alive until it returns, new queries see the latest one
+// and a replaced snapshot is freed with its last reader. Queries never wait
+// for an update to be built, only for the pointer copy inside the shared_ptr
+// atomics; updates wait for each other so that none is lost. The graph must
+// not change while the network is in use.
+//
+// Queries can also be submitted to a pool of worker threads, started by the
+// first submit, and are answered through concurrent.futures.Future objects.
+// A worker searches without the GIL and buffers its answers, taking the GIL
+// once to set a batch of futures when it runs out of work or the batch is
+// full.
+class Network {
+public:
+    Network(Graph* const _g, const bp::object &_wmin, const bp::object &_wmax, int _cache,
+            int _threads);
+
+    // waits for the submitted queries
+    ~Network();
+
+    // hyperpath from _oid to _did as (edge_idx, prob, cost)
+    bp::tuple hyperpath(const string &_oid, const string &_did);
+
+    // wmin distances from _oid to every vertex
+    np::ndarray shortest(const string &_oid);
+
+    // hyperpath as a Future of (edge_idx, prob, cost)
+    bp::object submit_run(const string &_oid, const string &_did);
+
+    // wmin distances as a Future of an ndarray
+    bp::object submit_shortest(const string &_oid);
+
+    // publishes new weights, of all edges when _edges is None or else of the
+    // listed ones, the others carried over; returns the new version
+    unsigned long update(const bp::object &_wmin, const bp::object &_wmax,
+                         const bp::object &_edges);
+
+    unsigned long get_version() const;
+
+    size_t get_workspaces() const;
+
+    // the searches of all queries answered so far
+    SearchStats get_total_stats() const;
+
+    void reset_stats();
+
+private:
+    // the answer of a submitted query, waiting for its future to be set
+    struct Answer {
+        PyObject* future; // a reference of its own
+        bool shortest;
+        vector<int> edges;
+        vector<float> probs;
+        float cost;
+        vector<float> u;
+    };
+
+    // the hyperpath from _o_idx to _d_idx; doesn't touch python objects
+    void search(int _o_idx, int _d_idx, vector<int> &_edges, vector<float> &_probs, float &_cost);
+
+    void check_no_turns() const;
+
+    // queues a query, returning the future of its answer
+    bp::object submit(int _o_idx, int _d_idx, bool _shortest);
+
+    // sets the futures of the answers buffered by _worker, under the GIL
+    void deliver(int _worker);
+
+    Graph* g;
+    Topology t;
+    shared_ptr<const WeightSnapshot> weights; // only through atomic_load/atomic_store
+    mutex update_lock; // serialises writers, readers don't take it
+    unique_ptr<PotentialCache> potentials; // none without a cache
+    WorkspacePool pool;
+    SearchStats total;
+    mutable mutex stats_lock;
+    int threads; // of the task pool, 0 for all cores
+    bp::object future_type; // concurrent.futures.Future
+    vector<vector<Answer> > outbox; // by worker
+    unique_ptr<TaskPool> tasks; // started by the first submit
+};
+
+#endif /* NETWORK_H */
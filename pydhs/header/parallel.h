@@ -0,0 +1,151 @@
+//
+//  parallel.h
+//  MyGraph
+//
+//  Minimal thread pools: parallel_for for the batch queries, TaskPool for
+//  queries submitted one at a time.
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads for _threads requested, 0 or less meaning all cores
+inline int worker_count(int _threads, size_t _items) {
+    if (_threads <= 0)
+        _threads = std::max(1u, std::thread::hardware_concurrency());
+    return int(std::max<size_t>(1, std::min<size_t>(_threads, _items)));
+}
+
+// calls _work(worker, item) for every item in [0, _items) on _workers threads.
+// Items are handed out in small chunks so that long queries don't leave the
+// other workers idle; worker is in [0, _workers) and owns its scratch space.
+template <class Work>
+void parallel_for(size_t _items, int _workers, Work _work) {
+    const size_t chunk = std::max<size_t>(1, std::min<size_t>(16, _items / (8 * _workers)));
+    std::atomic<size_t> next(0);
+    auto loop = [&](int worker) {
+        while (true) {
+            size_t begin = next.fetch_add(chunk);
+            if (begin >= _items)
+                break;
+            size_t end = std::min(_items, begin + chunk);
+            for (size_t i = begin; i < end; ++i)
+                _work(worker, i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int w = 1; w < _workers; ++w)
+        threads.push_back(std::thread(loop, w));
+    loop(0);
+    for (auto &t : threads)
+        t.join();
+}
+
+// long lived workers running tasks as they are submitted. Every worker has a
+// deque of its own; submits are dealt round robin, a worker takes the oldest
+// task of its deque and, when that is empty, steals from the others, so a
+// few slow tasks don't hold up the ones queued behind them. A worker calls
+// _idle before it goes to sleep, e.g. to flush what it has buffered. The
+// destructor runs the tasks still queued, then stops the workers.
+class TaskPool {
+public:
+    typedef std::function<void(int)> Task; // called with the worker index
+
+    TaskPool(int _threads, std::function<void(int)> _idle)
+        : idle(_idle), next(0), pending(0), stopping(false) {
+        int k = worker_count(_threads, size_t(-1));
+        for (int w = 0; w < k; ++w)
+            queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        for (int w = 0; w < k; ++w)
+            threads.push_back(std::thread(&TaskPool::work, this, w));
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    void submit(Task _task) {
+        Queue &q = *queues[next.fetch_add(1) % queues.size()];
+        {
+            std::lock_guard<std::mutex> guard(q.lock);
+            q.tasks.push_back(std::move(_task));
+        }
+        {
+            // counted under the sleep lock, a worker about to sleep sees it
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    int size() const { return int(threads.size()); }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    bool take(int _w, Task &_task) {
+        for (size_t k = 0; k < queues.size(); ++k) {
+            Queue &q = *queues[(_w + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.tasks.empty())
+                continue;
+            if (k == 0) {
+                _task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            } else {
+                // the newest of another worker, it has waited the least
+                _task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void work(int _w) {
+        Task task;
+        while (true) {
+            if (take(_w, task)) {
+                pending--;
+                task(_w);
+                task = nullptr;
+                continue;
+            }
+            idle(_w);
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [&] { return stopping || pending > 0; });
+            if (stopping && pending == 0)
+                return;
+        }
+    }
+
+    std::function<void(int)> idle;
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next;
+    std::atomic<long> pending; // submitted and not yet taken
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,65 @@
+//
+//  potential.h
+//  MyGraph
+//
+//  Node potentials for the hyperpath search and an LRU cache of them.
+//
+
+#ifndef POTENTIAL_H
+#define POTENTIAL_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "graph.h"
+
+using namespace std;
+
+// shortest distances from _root_idx over the out-edges of _t using
+// _weights; unreachable vertices are left at infinity
+void lower_bounds(const Topology &_t, const float *_weights, int _root_idx, float *_u);
+
+// LRU cache of lower-bound potentials keyed by root vertex and weight version.
+// Entries are handed out as shared pointers, so an evicted entry stays valid
+// for whoever is still reading it.
+class PotentialCache {
+public:
+    typedef shared_ptr<const vector<float> > Potentials;
+
+    PotentialCache(size_t _capacity);
+
+    // cached potentials of _root_idx, computed with lower_bounds on a miss
+    Potentials get(const Topology &_t, const float *_weights,
+                   unsigned long _version, int _root_idx);
+
+    void clear();
+
+    size_t size() const;
+
+    size_t get_hits() const;
+
+    size_t get_misses() const;
+
+private:
+    typedef pair<unsigned long, int> Key;
+
+    struct KeyHash {
+        size_t operator()(const Key &_k) const {
+            return hash<unsigned long>()(_k.first) * 31 + hash<int>()(_k.second);
+        }
+    };
+
+    typedef list<pair<Key, Potentials> > Entries;
+
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+    Entries entries; // most recently used first
+    unordered_map<Key, Entries::iterator, KeyHash> index;
+    mutable mutex lock;
+};
+
+#endif /* POTENTIAL_H */
@@ -0,0 +1,69 @@
+//
+//  profile.h
+//  MyGraph
+//
+//  Edge weights varying with the time of day.
+//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "graph.h"
+
+using namespace std;
+
+// weights of m edges as functions of the time an edge is entered, sampled
+// at t0 + k * bin_width for k < bins and held in one edge-major
+// [edge x bin] array. A binned profile keeps the value of a bin up to the
+// next one, a linear profile interpolates between the samples; both are
+// constant outside the sampled span.
+//
+// Where a weight drops faster than time passes, leaving later would arrive
+// earlier. The profile then evaluates to the wait for the later departure
+// instead, so every edge is FIFO and time dependent label setting stays
+// exact.
+class TimeProfile {
+public:
+    // _values holds the bins samples of edge 0, then those of edge 1, ...
+    TimeProfile(int _m, int _bins, float _t0, float _bin_width, bool _linear,
+                const vector<float> &_values);
+
+    // weight of edge _a_idx entered at time _t
+    inline float at(int _a_idx, float _t) const {
+        const float* w = &values[size_t(_a_idx) * bins];
+        float x = (_t - t0) / bin_width;
+        if (!(x > 0))
+            return min(w[0], t0 - _t + reach[size_t(_a_idx) * bins]);
+        int k = int(x);
+        if (k >= bins - 1)
+            return w[bins - 1];
+        float base = linear ? w[k] + (x - k) * (w[k + 1] - w[k]) : w[k];
+        return min(base, t0 + (k + 1) * bin_width - _t + reach[size_t(_a_idx) * bins + k + 1]);
+    }
+
+    int get_bins() const { return bins; }
+
+    float get_t0() const { return t0; }
+
+    float get_bin_width() const { return bin_width; }
+
+private:
+    int m;
+    int bins;
+    float t0;
+    float bin_width;
+    bool linear;
+    vector<float> values;
+    vector<float> reach; // least weight when entering at a sample time or later
+};
+
+// earliest arrival from _root_idx departing at _t, as travel times in _u
+// (infinity for unreachable vertices); _pre receives the edge into each
+// vertex when not null
+void td_arrivals(const Topology &_t, const TimeProfile &_w, int _root_idx, float _time,
+                 float *_u, int *_pre);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,110 @@
+//
+//  pyhelper.h
+//  MyGraph
+//
+//  Helpers shared by the python facing classes.
+//
+
+#ifndef PYHELPER_H
+#define PYHELPER_H
+
+#include <Python.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include "algorithm.h"
+#include "graph.h"
+#include "weights.h"
+
+namespace bp = boost::python;
+namespace np = boost::python::numpy;
+
+// releases the GIL for the lifetime of the object; nothing inside the scope
+// may touch python objects
+class ScopedGILRelease {
+public:
+    ScopedGILRelease() { state = PyEval_SaveThread(); }
+    ~ScopedGILRelease() { PyEval_RestoreThread(state); }
+private:
+    PyThreadState* state;
+};
+
+// copies a vector into a new 1-d numpy array of the same element type
+template <class T>
+np::ndarray to_ndarray(const std::vector<T> &_v) {
+    np::ndarray arr = np::empty(bp::make_tuple(_v.size()), np::dtype::get_builtin<T>());
+    if (!_v.empty())
+        std::memcpy(arr.get_data(), _v.data(), _v.size() * sizeof(T));
+    return arr;
+}
+
+// float copy of the first _size elements of a sequence
+inline std::vector<float> to_floats(const bp::object &_seq, size_t _size) {
+    std::vector<float> v(_size);
+    for (size_t i = 0; i < _size; ++i)
+        v[i] = bp::extract<float>(_seq[i]);
+    return v;
+}
+
+// copies the first _size elements of a sequence to _out; a 1-d float32
+// array by copy_weights, other sequences element by element
+inline void copy_floats(const bp::object &_seq, float* _out, size_t _size) {
+    bp::extract<np::ndarray> arr(_seq);
+    if (arr.check()) {
+        np::ndarray a = arr();
+        if (a.get_dtype() == np::dtype::get_builtin<float>() && a.get_nd() == 1
+            && size_t(a.shape(0)) >= _size) {
+            copy_weights(a.get_data(), a.strides(0), _out, _size);
+            return;
+        }
+    }
+    for (size_t i = 0; i < _size; ++i)
+        _out[i] = bp::extract<float>(_seq[i]);
+}
+
+// row-major float copy of a 2-d array with _rows rows; _cols receives the
+// column count
+inline std::vector<float> to_matrix(const bp::object &_arr, size_t _rows, int &_cols) {
+    np::ndarray a = np::from_object(_arr, np::dtype::get_builtin<float>(), 2, 2,
+                                    np::ndarray::CARRAY_RO);
+    if (size_t(a.shape(0)) != _rows || a.shape(1) < 1) {
+        PyErr_SetString(PyExc_ValueError, "expected one row per edge");
+        bp::throw_error_already_set();
+    }
+    _cols = a.shape(1);
+    std::vector<float> v(_rows * _cols);
+    std::memcpy(v.data(), a.get_data(), v.size() * sizeof(float));
+    return v;
+}
+
+// the stats of searches as a dict of their counters and ns timings
+inline bp::dict to_dict(const SearchStats &_s) {
+    bp::dict d;
+    d["searches"] = _s.searches;
+    d["search_ns"] = _s.search_ns;
+    d["sort_ns"] = _s.sort_ns;
+    d["load_ns"] = _s.load_ns;
+    d["output_ns"] = _s.output_ns;
+    d["vertices_scanned"] = _s.vertices_scanned;
+    d["edges_scanned"] = _s.edges_scanned;
+    d["inserts"] = _s.inserts;
+    d["decrease_keys"] = _s.decrease_keys;
+    d["delete_mins"] = _s.delete_mins;
+    d["comparisons"] = _s.comparisons;
+    d["stopped_at_origin"] = _s.stopped_at_origin;
+    d["exhausted"] = _s.exhausted;
+    return d;
+}
+
+// vertex indices of a sequence of vertex id strings
+inline std::vector<int> to_vidx(Graph* _g, const bp::object &_ids) {
+    size_t k = bp::len(_ids);
+    std::vector<int> idx(k);
+    for (size_t i = 0; i < k; ++i)
+        idx[i] = _g->get_vidx(bp::extract<std::string>(_ids[i]));
+    return idx;
+}
+
+#endif /* PYHELPER_H */
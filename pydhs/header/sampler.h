@@ -0,0 +1,60 @@
+//
+//  sampler.h
+//  MyGraph
+//
+//  Drawing concrete routes from a hyperpath.
+//
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <vector>
+#include "graph.h"
+
+using namespace std;
+
+// splitmix64 generator, small and fast enough to be seeded per batch
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t _seed) : state(_seed) {}
+
+    inline uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    inline double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t state;
+};
+
+// Walker alias tables of the edge choices at every vertex of a hyperpath,
+// built once from the edge possibilities so that every step of a route is
+// drawn in constant time
+class RouteSampler {
+public:
+    // _edges/_probs as left by a search: the attractive edges carrying flow
+    // and their possibilities p_a
+    RouteSampler(const Topology &_t, const vector<int> &_edges, const vector<float> &_probs);
+
+    // appends the edges of one route from _o_idx to _d_idx to _route;
+    // returns false, leaving no edges, when _o_idx has no choice
+    bool sample(int _o_idx, int _d_idx, SplitMix64 &_rng, vector<int> &_route) const;
+
+private:
+    const Topology &t;
+    vector<int> first; // by vertex, start of its choices or -1
+    vector<int> count; // by vertex
+    vector<int> choice; // edges grouped by tail
+    vector<float> keep; // chance of keeping a slot's own edge
+    vector<int> alias; // slot taken otherwise
+};
+
+#endif /* SAMPLER_H */
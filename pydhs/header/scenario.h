@@ -0,0 +1,62 @@
+//
+//  scenario.h
+//  MyGraph
+//
+//  Shortest paths under several weight scenarios in one traversal.
+//
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include <vector>
+#include "algorithm.h"
+#include "graph.h"
+#include "fibheap.h"
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+using namespace std;
+namespace bp = boost::python;
+namespace np = boost::python::numpy;
+
+// relaxes all lanes of an edge, _uj = min(_uj, _ui + _wa); returns whether
+// any lane improved and lowers _best to the least improved label
+typedef bool (*LaneRelax)(const float* _ui, const float* _wa, float* _uj,
+                          int _lanes, float &_best);
+
+// the widest relax kernel the cpu supports: AVX-512, AVX2 or plain loops
+LaneRelax lane_relax();
+
+// Dijkstra over S weight scenarios at once. Weights and labels are stored
+// [edge x lane] and [vertex x lane], the S scenarios padded to a multiple of
+// 8 lanes, so relaxing an edge is a few vector operations for all of them.
+// Scenarios settle vertices in different orders, so the search is label
+// correcting: a vertex is keyed by the least label improved since it was
+// last scanned and is scanned again whenever a lane improves.
+class ScenarioDijkstra: public Algorithm {
+private:
+    Graph* g;
+    int scenarios;
+    int lanes;
+    vector<float> weights; // [edge x lane]
+    vector<float> u; // [vertex x lane]
+    vector<float> pending; // heap key of the queued vertices
+    vector<char> open;
+    LaneRelax relax;
+
+public:
+    ScenarioDijkstra(Graph* const _g);
+
+    // m*S array, one column per scenario
+    void set_weights(const bp::object &_weights);
+
+    void run(const string &_oid);
+
+    // n*S array of the distances from the last origin
+    np::ndarray get_potentials() const;
+
+    int get_scenarios() const;
+};
+
+#endif /* SCENARIO_H */
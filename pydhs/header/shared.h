@@ -0,0 +1,77 @@
+//
+//  shared.h
+//  MyGraph
+//
+//  A graph and its weights in a POSIX shared memory segment, so that the
+//  processes of a pool use one copy of the network instead of one each.
+//
+//  The segment holds the topology arrays, the turns, wmin and wmax, and the
+//  vertex and edge ids with open addressing tables to look them up. All of
+//  it is laid out flat at fixed offsets, so attaching is one mmap and a
+//  header check, however large the graph. Attached segments are read-only.
+//
+
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "graph.h"
+
+using namespace std;
+
+class SharedGraph : public GraphStore {
+public:
+    // copies _g and its weights into a new segment called _name, which
+    // mustn't exist yet. The segment is removed when the returned owner is
+    // destroyed, or by unlink; processes attached by then keep their mapping.
+    static shared_ptr<SharedGraph> create(const string &_name, Graph &_g,
+                                          const float* _wmin, const float* _wmax);
+
+    // maps the segment _name read-only
+    static shared_ptr<SharedGraph> attach(const string &_name);
+
+    ~SharedGraph();
+
+    // removes the name, new attaches fail from then on
+    void unlink();
+
+    const string& get_name() const { return name; }
+    size_t get_size() const { return size; }
+    bool is_owner() const { return owner; }
+    const float* get_wmin() const { return wmin; }
+    const float* get_wmax() const { return wmax; }
+
+    const Topology& get_topology() const { return topology; }
+    int find_vertex(const string &_id) const;
+    int find_edge(const string &_id) const;
+    string get_vertex_id(int _idx) const;
+    string get_edge_id(int _idx) const;
+
+private:
+    SharedGraph(const string &_name, const void* _base, size_t _size, bool _owner);
+
+    // an id table: the ids of idx i are chars[offset[i]..offset[i+1]), slot
+    // holds idx or -1 for empty, probed linearly from the id's hash
+    struct Ids {
+        const uint64_t* offset;
+        const char* chars;
+        const int32_t* slot;
+        uint32_t mask; // slot count - 1
+    };
+
+    static int find(const Ids &_ids, const string &_id);
+
+    string name;
+    const void* base;
+    size_t size;
+    bool owner;
+    Topology topology;
+    const float* wmin;
+    const float* wmax;
+    Ids vertex_ids;
+    Ids edge_ids;
+};
+
+#endif /* SHARED_H */
@@ -0,0 +1,26 @@
+//
+//  weights.h
+//  MyGraph
+//
+//  How set_weights takes a float32 buffer into an engine, free of python so
+//  that native tools can link it.
+//
+
+#ifndef WEIGHTS_H
+#define WEIGHTS_H
+
+#include <cstddef>
+#include <cstring>
+
+// copies _size floats, _stride bytes apart from _data on, to _out: a
+// contiguous buffer, such as a LinkProfile bin, in one memcpy
+inline void copy_weights(const char* _data, std::ptrdiff_t _stride, float* _out, size_t _size) {
+    if (_stride == sizeof(float)) {
+        std::memcpy(_out, _data, _size * sizeof(float));
+        return;
+    }
+    for (size_t i = 0; i < _size; ++i)
+        std::memcpy(&_out[i], _data + std::ptrdiff_t(i) * _stride, sizeof(float));
+}
+
+#endif /* WEIGHTS_H */
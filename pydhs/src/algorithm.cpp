@@ -7,29 +7,20 @@
 
 #include "algorithm.h"
 
-Algorithm::Algorithm() {
-    start_ms = get_now_ms();
+void Algorithm::record(const SearchStats &_s) {
+    stats = _s;
+    total.add(_s);
 }
 
-Algorithm::~Algorithm() {
-    //TODO Auto-generated destructor stub
+const SearchStats& Algorithm::get_stats() const {
+    return stats;
 }
 
-int Algorithm::get_now_ms() const
-{
-    timeb tb;
-    ftime(&tb);
-    int nCount = tb.millitm + (tb.time & 0xfffff) * 1000;
-    return nCount;
+const SearchStats& Algorithm::get_total_stats() const {
+    return total;
 }
 
-int Algorithm::get_elapesd_ms() const{
-    int nSpan = get_now_ms() - start_ms;
-    if (nSpan < 0)
-        nSpan += 0x100000 * 1000;
-    return nSpan;
+void Algorithm::reset_stats() {
+    stats.clear();
+    total.clear();
 }
-
-
-
-
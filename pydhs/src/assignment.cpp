@@ -0,0 +1,209 @@
+//
+//  assignment.cpp
+//  MyGraph
+//
+
+#include "assignment.h"
+#include "parallel.h"
+#include "pyhelper.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+Demand group_demand(const vector<int> &_o_idx, const vector<int> &_d_idx,
+                    const vector<float> &_volume) {
+    vector<size_t> order(_d_idx.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&](size_t a, size_t b) { return _d_idx[a] < _d_idx[b]; });
+
+    Demand demand;
+    for (const auto &i : order) {
+        if (_volume[i] == 0)
+            continue;
+        if (demand.d_idx.empty() || demand.d_idx.back() != _d_idx[i]) {
+            demand.d_idx.push_back(_d_idx[i]);
+            demand.offset.push_back(demand.o_idx.size());
+        }
+        demand.o_idx.push_back(_o_idx[i]);
+        demand.volume.push_back(_volume[i]);
+    }
+    demand.offset.push_back(demand.o_idx.size());
+    return demand;
+}
+
+NetworkLoader::NetworkLoader(const Topology &_t, int _threads, size_t _tasks) : t(_t) {
+    workers = worker_count(_threads, _tasks);
+    for (int w = 0; w < workers; ++w) {
+        spaces.push_back(unique_ptr<HyperpathWorkspace>(new HyperpathWorkspace(t.n, t.m, t.turn_cnt)));
+        flows.push_back(vector<double>(t.m, 0.0));
+    }
+}
+
+// every worker adds into its own flow buffer, the buffers are summed at the end
+void NetworkLoader::load(const HyperpathWeights &_w, const Demand &_demand,
+                         vector<double> &_flow) {
+    for (auto &flow : flows)
+        fill(flow.begin(), flow.end(), 0.0);
+
+    parallel_for(_demand.d_idx.size(), workers, [&](int w, size_t k) {
+        HyperpathWorkspace &space = *spaces[w];
+        size_t begin = _demand.offset[k];
+        hyperpath_demand(t, _w, _demand.d_idx[k], &_demand.o_idx[begin],
+                         &_demand.volume[begin], _demand.offset[k + 1] - begin, space);
+        vector<double> &flow = flows[w];
+        for (const auto &a_idx : space.po_edges)
+            flow[a_idx] += space.p_a[a_idx];
+    });
+
+    _flow.assign(t.m, 0.0);
+    for (const auto &flow : flows) {
+        for (int a = 0; a < t.m; ++a)
+            _flow[a] += flow[a];
+    }
+}
+
+SearchStats NetworkLoader::get_stats() const {
+    SearchStats s;
+    for (const auto &space : spaces)
+        s.add(space->stats);
+    return s;
+}
+
+void BPR::apply(const vector<float> &_t0, const vector<float> &_capacity,
+                const vector<double> &_flow, vector<float> &_t) const {
+    _t.resize(_t0.size());
+    for (size_t a = 0; a < _t0.size(); ++a) {
+        if (_capacity[a] > 0)
+            _t[a] = _t0[a] * (1 + alpha * pow(_flow[a] / _capacity[a], double(beta)));
+        else
+            _t[a] = _t0[a];
+    }
+}
+
+// the gap is sum |y - x| / sum x between the auxiliary flows y of the current
+// weights and the averaged flows x
+int equilibrium(const Topology &_t, const vector<float> &_wmin0, const vector<float> &_wmax0,
+                const vector<float> &_capacity, const Demand &_demand, const BPR &_bpr,
+                int _max_iter, double _tol, int _threads, int _iteration,
+                vector<double> &_flow, vector<float> &_wmin, vector<float> &_wmax,
+                vector<double> &_gaps, SearchStats &_stats) {
+    NetworkLoader loader(_t, _threads, _demand.d_idx.size());
+    HyperpathWeights w;
+    w.h = nullptr;
+    vector<double> aux;
+    _gaps.clear();
+
+    // k is the number of loads averaged into _flow so far
+    int k = max(1, _iteration);
+    if (_flow.size() != size_t(_t.m)) {
+        w.wmin = _wmin0.data();
+        w.wmax = _wmax0.data();
+        loader.load(w, _demand, _flow);
+        k = 1;
+    }
+    for (int iter = 0; iter < _max_iter; ++iter) {
+        _bpr.apply(_wmin0, _capacity, _flow, _wmin);
+        _bpr.apply(_wmax0, _capacity, _flow, _wmax);
+        w.wmin = _wmin.data();
+        w.wmax = _wmax.data();
+        loader.load(w, _demand, aux);
+
+        double diff = 0;
+        double total = 0;
+        for (int a = 0; a < _t.m; ++a) {
+            diff += fabs(aux[a] - _flow[a]);
+            total += _flow[a];
+        }
+        double gap = total > 0 ? diff / total : 0;
+        _gaps.push_back(gap);
+        if (gap < _tol)
+            break;
+
+        k++;
+        double step = 1.0 / k;
+        for (int a = 0; a < _t.m; ++a)
+            _flow[a] += step * (aux[a] - _flow[a]);
+    }
+    _bpr.apply(_wmin0, _capacity, _flow, _wmin);
+    _bpr.apply(_wmax0, _capacity, _flow, _wmax);
+    _stats = loader.get_stats();
+    return k;
+}
+
+// demand rows of (origin, destination, volume); the volume may be a string
+// when the rows come from a numpy string array
+static Demand read_demand(Graph* _g, const bp::object &_od) {
+    size_t k = bp::len(_od);
+    vector<int> o_idx(k);
+    vector<int> d_idx(k);
+    vector<float> volume(k);
+    for (size_t i = 0; i < k; ++i) {
+        o_idx[i] = _g->get_vidx(bp::extract<string>(_od[i][0]));
+        d_idx[i] = _g->get_vidx(bp::extract<string>(_od[i][1]));
+        bp::object v = _od[i][2];
+        bp::extract<float> volume_i(v);
+        volume[i] = volume_i.check() ? volume_i() : stof(bp::extract<string>(v)());
+    }
+    return group_demand(o_idx, d_idx, volume);
+}
+
+np::ndarray load_demand(Graph* _g, const bp::object &_wmin, const bp::object &_wmax,
+                        const bp::object &_od, int _threads) {
+    size_t m = _g->get_edge_number();
+    vector<float> wmin = to_floats(_wmin, m);
+    vector<float> wmax = to_floats(_wmax, m);
+    Demand demand = read_demand(_g, _od);
+
+    const Topology &t = _g->get_topology();
+    HyperpathWeights w;
+    w.wmin = wmin.data();
+    w.wmax = wmax.data();
+    w.h = nullptr;
+    vector<double> flow;
+    {
+        ScopedGILRelease nogil;
+        NetworkLoader(t, _threads, demand.d_idx.size()).load(w, demand, flow);
+    }
+    return to_ndarray(flow);
+}
+
+bp::dict assign_equilibrium(Graph* _g, const bp::object &_wmin, const bp::object &_wmax,
+                            const bp::object &_capacity, const bp::object &_od,
+                            float _alpha, float _beta, int _max_iter, double _tol,
+                            int _threads, const bp::object &_flow, int _iteration) {
+    size_t m = _g->get_edge_number();
+    vector<float> wmin0 = to_floats(_wmin, m);
+    vector<float> wmax0 = to_floats(_wmax, m);
+    vector<float> capacity = to_floats(_capacity, m);
+    Demand demand = read_demand(_g, _od);
+    vector<double> flow;
+    if (!_flow.is_none()) {
+        flow.resize(m);
+        for (size_t a = 0; a < m; ++a)
+            flow[a] = bp::extract<double>(_flow[a]);
+    }
+
+    const Topology &t = _g->get_topology();
+    BPR bpr;
+    bpr.alpha = _alpha;
+    bpr.beta = _beta;
+    vector<float> wmin;
+    vector<float> wmax;
+    vector<double> gaps;
+    SearchStats stats;
+    int iteration = 0;
+    {
+        ScopedGILRelease nogil;
+        iteration = equilibrium(t, wmin0, wmax0, capacity, demand, bpr, _max_iter, _tol,
+                                _threads, _iteration, flow, wmin, wmax, gaps, stats);
+    }
+    bp::dict result;
+    result["flow"] = to_ndarray(flow);
+    result["wmin"] = to_ndarray(wmin);
+    result["wmax"] = to_ndarray(wmax);
+    result["gap"] = to_ndarray(gaps);
+    result["iteration"] = iteration;
+    result["stats"] = to_dict(stats);
+    return result;
+}
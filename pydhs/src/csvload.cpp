@@ -0,0 +1,366 @@
+//
+//  csvload.cpp
+//  MyGraph
+//
+
+#include "csvload.h"
+#include "parallel.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct Field {
+    const char* p;
+    size_t len;
+};
+
+// read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile(const string &_path) : data(nullptr), size(0) {
+        int fd = open(_path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw "ERROR: can't read " + _path;
+        struct stat st;
+        st.st_size = 0;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const char*>(p);
+                size = st.st_size;
+                madvise(p, size, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        if (!data && st.st_size > 0)
+            throw "ERROR: can't map " + _path;
+    }
+
+    ~MappedFile() {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+    }
+
+    const char* data;
+    size_t size;
+};
+
+// the line from _p, without its line end; _next is where the next one starts
+inline const char* line_end(const char* _p, const char* _end, const char* &_next) {
+    const char* e = static_cast<const char*>(memchr(_p, '\n', _end - _p));
+    if (!e)
+        e = _end;
+    _next = e < _end ? e + 1 : e;
+    if (e > _p && e[-1] == '\r')
+        --e;
+    return e;
+}
+
+void split(const char* _p, const char* _e, char _delimiter, vector<Field> &_fields) {
+    _fields.clear();
+    while (true) {
+        const char* d = static_cast<const char*>(memchr(_p, _delimiter, _e - _p));
+        Field f = {_p, size_t((d ? d : _e) - _p)};
+        _fields.push_back(f);
+        if (!d)
+            return;
+        _p = d + 1;
+    }
+}
+
+const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// decimal numbers of up to 15 significant digits are exact in a double and
+// scaled by one exact power of ten; anything else goes to strtod
+bool parse_float(const char* _p, const char* _e, float &_x) {
+    while (_p < _e && (*_p == ' ' || *_p == '\t'))
+        ++_p;
+    while (_e > _p && (_e[-1] == ' ' || _e[-1] == '\t'))
+        --_e;
+    const char* q = _p;
+    bool negative = false;
+    if (q < _e && (*q == '-' || *q == '+'))
+        negative = *q++ == '-';
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; q < _e && *q >= '0' && *q <= '9'; ++q) {
+        any = true;
+        if (mantissa == 0 && *q == '0')
+            continue;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*q - '0');
+            digits++;
+        } else {
+            exponent++;
+        }
+    }
+    if (q < _e && *q == '.') {
+        for (++q; q < _e && *q >= '0' && *q <= '9'; ++q) {
+            any = true;
+            if (mantissa == 0 && *q == '0') {
+                exponent--;
+                continue;
+            }
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*q - '0');
+                digits++;
+                exponent--;
+            }
+        }
+    }
+    if (any && q < _e && (*q == 'e' || *q == 'E')) {
+        const char* r = q + 1;
+        bool minus = false;
+        if (r < _e && (*r == '-' || *r == '+'))
+            minus = *r++ == '-';
+        int k = 0;
+        bool exp_digits = false;
+        for (; r < _e && *r >= '0' && *r <= '9'; ++r) {
+            exp_digits = true;
+            if (k < 10000)
+                k = k * 10 + (*r - '0');
+        }
+        if (exp_digits) {
+            exponent += minus ? -k : k;
+            q = r;
+        }
+    }
+    if (any && q == _e && digits <= 15 && exponent >= -22 && exponent <= 22) {
+        double x = double(mantissa);
+        x = exponent < 0 ? x / POW10[-exponent] : x * POW10[exponent];
+        _x = float(negative ? -x : x);
+        return true;
+    }
+    // inf, nan, long mantissas and large exponents
+    string s(_p, _e);
+    char* end = nullptr;
+    _x = strtof(s.c_str(), &end);
+    return !s.empty() && end == s.c_str() + s.size();
+}
+
+// the rows of one chunk, up to its first malformed line
+struct Chunk {
+    const char* begin;
+    const char* end;
+    vector<Field> ids; // the id fields of each row
+    vector<float> weights; // the numbers of each row
+    size_t lines;
+    size_t error_line; // lines before the bad one, valid when error is set
+    string error;
+};
+
+// chunks of about equal size, each ending at a line end; one for a small
+// file or a single thread
+vector<Chunk> cut_chunks(const char* _begin, const char* _end, int _threads) {
+    const size_t bytes = _end - _begin;
+    const int workers = worker_count(_threads, bytes / (1 << 20) + 1);
+    const size_t pieces = workers > 1 ? size_t(workers) * 4 : 1;
+    vector<Chunk> chunks(pieces);
+    const char* p = _begin;
+    for (size_t c = 0; c < pieces; ++c) {
+        chunks[c].begin = p;
+        const char* e = c + 1 == pieces ? _end : _begin + bytes * (c + 1) / pieces;
+        if (e < p)
+            e = p;
+        if (e < _end) {
+            const char* nl = static_cast<const char*>(memchr(e, '\n', _end - e));
+            e = nl ? nl + 1 : _end;
+        }
+        chunks[c].end = e;
+        p = e;
+    }
+    return chunks;
+}
+
+// throws the error of the first bad chunk with its line number in the file;
+// _skipped lines come before the first chunk
+void check_chunks(const vector<Chunk> &_chunks, size_t _skipped, const string &_path) {
+    size_t line = _skipped;
+    for (const auto &c : _chunks) {
+        if (!c.error.empty())
+            throw "ERROR: line " + to_string(line + c.error_line + 1) + " of " + _path + " "
+                + c.error;
+        line += c.lines;
+    }
+}
+
+void parse_chunk(Chunk &_c, const vector<int> &_cols, int _width, char _delimiter) {
+    vector<Field> fields;
+    const size_t k = _cols.size() - 3;
+    _c.lines = 0;
+    const char* next;
+    for (const char* p = _c.begin; p < _c.end; p = next) {
+        const char* e = line_end(p, _c.end, next);
+        _c.lines++;
+        if (e == p)
+            continue;
+        split(p, e, _delimiter, fields);
+        if (int(fields.size()) < _width) {
+            _c.error_line = _c.lines - 1;
+            _c.error = "has " + to_string(fields.size()) + " columns";
+            return;
+        }
+        for (int j = 0; j < 3; ++j)
+            _c.ids.push_back(fields[_cols[j]]);
+        for (size_t j = 0; j < k; ++j) {
+            const Field &f = fields[_cols[3 + j]];
+            float x;
+            if (!parse_float(f.p, f.p + f.len, x)) {
+                _c.error_line = _c.lines - 1;
+                _c.error = "has a bad number: " + string(f.p, f.len);
+                return;
+            }
+            _c.weights.push_back(x);
+        }
+    }
+}
+
+
+// rows of a key and _width numbers
+void parse_table_chunk(Chunk &_c, size_t _width, char _delimiter) {
+    vector<Field> fields;
+    _c.lines = 0;
+    const char* next;
+    for (const char* p = _c.begin; p < _c.end; p = next) {
+        const char* e = line_end(p, _c.end, next);
+        _c.lines++;
+        if (e == p)
+            continue;
+        split(p, e, _delimiter, fields);
+        if (fields.size() != _width + 1) {
+            _c.error_line = _c.lines - 1;
+            _c.error = "has " + to_string(fields.size()) + " columns, not "
+                + to_string(_width + 1);
+            return;
+        }
+        _c.ids.push_back(fields[0]);
+        for (size_t j = 1; j <= _width; ++j) {
+            float x;
+            if (!parse_float(fields[j].p, fields[j].p + fields[j].len, x)) {
+                _c.error_line = _c.lines - 1;
+                _c.error = "has a bad number: " + string(fields[j].p, fields[j].len);
+                return;
+            }
+            _c.weights.push_back(x);
+        }
+    }
+}
+
+}
+
+Graph* load_csv_graph(const string &_path, const CsvColumns &_columns, int _header,
+                      char _delimiter, int _threads, vector<vector<float> > &_weights) {
+    MappedFile file(_path);
+    const char* begin = file.data;
+    const char* end = file.data + file.size;
+
+    // the first line decides on the header and the columns
+    vector<Field> first;
+    const char* second = begin;
+    if (file.size > 0)
+        split(begin, line_end(begin, end, second), _delimiter, first);
+    vector<int> cols = _columns.index;
+    if (!_columns.name.empty()) {
+        _header = 1;
+        cols.clear();
+        for (const auto &name : _columns.name) {
+            size_t j = 0;
+            while (j < first.size() && string(first[j].p, first[j].len) != name)
+                ++j;
+            if (j == first.size())
+                throw "ERROR: no column " + name + " in " + _path;
+            cols.push_back(int(j));
+        }
+    } else if (cols.empty()) {
+        for (size_t j = 0; j < max<size_t>(3, first.size()); ++j)
+            cols.push_back(int(j));
+    }
+    if (cols.size() < 3)
+        throw string("ERROR: columns must name eid, fvid and tvid before the weights");
+    int width = 0;
+    for (const auto &j : cols) {
+        if (j < 0)
+            throw string("ERROR: negative column index");
+        width = max(width, j + 1);
+    }
+    if (_header < 0) {
+        _header = int(first.size()) < width;
+        float x;
+        for (size_t j = 3; j < cols.size() && !_header; ++j)
+            _header = !parse_float(first[cols[j]].p, first[cols[j]].p + first[cols[j]].len, x);
+    }
+    if (_header)
+        begin = second;
+
+    vector<Chunk> chunks = cut_chunks(begin, end, _threads);
+    const int workers = worker_count(_threads, chunks.size());
+    parallel_for(chunks.size(), workers, [&](int, size_t c) {
+        parse_chunk(chunks[c], cols, width, _delimiter);
+    });
+    check_chunks(chunks, _header ? 1 : 0, _path);
+    size_t m = 0;
+    for (const auto &c : chunks)
+        m += c.ids.size() / 3;
+
+    const size_t k = cols.size() - 3;
+    _weights.assign(k, vector<float>());
+    for (auto &w : _weights)
+        w.reserve(m);
+    // at most two new vertices per edge, the Graph only reserves pointers
+    unique_ptr<Graph> g(new Graph(int(2 * m), int(m)));
+    for (const auto &c : chunks) {
+        for (size_t r = 0; r < c.ids.size() / 3; ++r) {
+            const Field* f = &c.ids[3 * r];
+            size_t before = g->get_edge_number();
+            g->add_edge(string(f[0].p, f[0].len), string(f[1].p, f[1].len),
+                        string(f[2].p, f[2].len));
+            // a repeated edge id is skipped with its weights
+            if (g->get_edge_number() > before) {
+                for (size_t j = 0; j < k; ++j)
+                    _weights[j].push_back(c.weights[k * r + j]);
+            }
+        }
+    }
+    return g.release();
+}
+
+void load_csv_table(const string &_path, char _delimiter, int _threads, vector<string> &_header,
+                    vector<string> &_keys, vector<float> &_values) {
+    MappedFile file(_path);
+    const char* begin = file.data;
+    const char* end = file.data + file.size;
+    if (file.size == 0)
+        throw "ERROR: " + _path + " is empty";
+    vector<Field> first;
+    const char* second;
+    split(begin, line_end(begin, end, second), _delimiter, first);
+    begin = second;
+    _header.clear();
+    for (size_t j = 1; j < first.size(); ++j)
+        _header.push_back(string(first[j].p, first[j].len));
+
+    vector<Chunk> chunks = cut_chunks(begin, end, _threads);
+    const int workers = worker_count(_threads, chunks.size());
+    parallel_for(chunks.size(), workers, [&](int, size_t c) {
+        parse_table_chunk(chunks[c], _header.size(), _delimiter);
+    });
+    check_chunks(chunks, 1, _path);
+    _keys.clear();
+    _values.clear();
+    for (auto &c : chunks) {
+        for (const auto &f : c.ids)
+            _keys.push_back(string(f.p, f.len));
+        _values.insert(_values.end(), c.weights.begin(), c.weights.end());
+        vector<float>().swap(c.weights);
+    }
+}
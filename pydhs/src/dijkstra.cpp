@@ -7,6 +7,8 @@
 // ========================================================
 
 #include "dijkstra.h"
+#include "fibheap.h"
+#include "pyhelper.h"
 #include <sstream>
 #include <iostream>
 #include <algorithm>
@@ -28,12 +30,28 @@ Dijkstra::Dijkstra(Graph* const _g)
 
     weights = new float[m]; //vertices with P labels
 
+    profile = nullptr;
+    edge_based = false;
+    reverse = false;
+    u_e = new float[m];
+    pre_e = new int[m];
+    open_e = new bool[m];
+    close_e = new bool[m];
+    last_e = new int[n];
     
     for (unsigned int i=0;i<n;++i){
         u[i] = numeric_limits<float>::infinity();
         pre_idx[i] = -1;
         open[i] = false;
         close[i] = false;
+        last_e[i] = -1;
+    }
+
+    for (unsigned int i=0;i<m;++i){
+        u_e[i] = numeric_limits<float>::infinity();
+        pre_e[i] = -1;
+        open_e[i] = false;
+        close_e[i] = false;
     }
 
 }
@@ -47,24 +65,47 @@ Dijkstra::~Dijkstra(){
     open = nullptr;
     delete [] close;
     close = nullptr;
-    delete weights;
+    delete [] weights;
     weights = nullptr;
+    delete [] u_e;
+    u_e = nullptr;
+    delete [] pre_e;
+    pre_e = nullptr;
+    delete [] open_e;
+    open_e = nullptr;
+    delete [] close_e;
+    close_e = nullptr;
+    delete [] last_e;
+    last_e = nullptr;
+    delete profile;
+    profile = nullptr;
 }
 
 void Dijkstra::set_weights(const bp::object& _weight){
-    size_t m = g->get_edge_number();
-    for (unsigned int i=0;i<m;++i){
-        weights[i] = bp::extract<float>(_weight[i]);
-    }
+    copy_floats(_weight, weights, g->get_edge_number());
+}
+
+DijkstraLabels Dijkstra::labels(){
+    DijkstraLabels l;
+    l.u = u;
+    l.pre_idx = pre_idx;
+    l.open = open;
+    l.close = close;
+    l.last_e = last_e;
+    return l;
 }
 
 void Dijkstra::recover(){
-    size_t n = g->get_vertex_number();
-    for (unsigned int i=0;i<n;++i){
-        u[i] = numeric_limits<float>::infinity();
-        pre_idx[i] = -1;
-        open[i] = false;
-        close[i] = false;
+    dijkstra_recover(g->get_vertex_number(), labels());
+    if (edge_based) {
+        size_t m = g->get_edge_number();
+        for (unsigned int i=0;i<m;++i){
+            u_e[i] = numeric_limits<float>::infinity();
+            pre_e[i] = -1;
+            open_e[i] = false;
+            close_e[i] = false;
+        }
+        edge_based = false;
     }
 }
 
@@ -79,65 +120,181 @@ bp::list Dijkstra::get_potentials(){
 
 void Dijkstra::run(string _oid){
     size_t n = g->get_vertex_number();
-    HeapD<RadixHeap> heapD;
-    Heap* heap = heapD.newInstance(n);
+    auto o_idx = g->get_vidx(_oid);
+    const Topology t = topology();
+    if (t.turn_cnt > 0) {
+        run_edges(o_idx);
+        return;
+    }
+
+    RadixHeap heap(n);
+    SearchStats s;
+    int64_t start = now_ns();
+    dijkstra_search(t, weights, o_idx, heap, labels(), s);
+    s.search_ns = now_ns() - start;
+    record(s);
+}
+
+void Dijkstra::set_profile(const bp::object& _weight, float _t0, float _bin_width, bool _linear){
+    size_t m = g->get_edge_number();
+    int bins = 0;
+    vector<float> values = to_matrix(_weight, m, bins);
+    if (!(_bin_width > 0)) {
+        PyErr_SetString(PyExc_ValueError, "bin_width must be positive");
+        bp::throw_error_already_set();
+    }
+    delete profile;
+    profile = new TimeProfile(m, bins, _t0, _bin_width, _linear, values);
+}
 
+// earliest arrivals departing at _time; the potentials are travel times
+void Dijkstra::run_at(string _oid, float _time){
     auto o_idx = g->get_vidx(_oid);
-    
+    const Topology &t = g->get_topology();
+    if (profile == nullptr || t.turn_cnt > 0 || reverse) {
+        PyErr_SetString(PyExc_ValueError, profile == nullptr ?
+                        "no profile set, call set_profile first" :
+                        "run_at doesn't support turn tables or reverse searches");
+        bp::throw_error_already_set();
+    }
+    if (edge_based)
+        recover();
+    vector<int> pre(t.n);
+    SearchStats s;
+    int64_t start = now_ns();
+    td_arrivals(t, *profile, o_idx, _time, u, pre.data());
+    s.searches = 1;
+    s.exhausted = 1;
+    s.search_ns = now_ns() - start;
+    record(s);
+    for (int i = 0; i < t.n; ++i) {
+        pre_idx[i] = pre[i] < 0 ? -1 : t.tail[pre[i]];
+        close[i] = u[i] != numeric_limits<float>::infinity();
+    }
+}
+
+// label setting over the edges as the vertices of the line graph: settling
+// edge a relaxes the edges b out of its head by u_e[a] + penalty + w[b],
+// skipping restricted turns. A vertex label is the best of its in-edges, so
+// a path may pass a vertex twice, e.g. to go round a banned turn. The radix
+// heap only orders fractional keys to within 1, so the edge labels use the
+// fibonacci heap to stay exact.
+void Dijkstra::run_edges(int _o_idx){
+    const Topology &t = g->get_topology(); // never reversed, topology() refuses turns
+    HeapD<FHeap> heapD;
+    Heap* heap = heapD.newInstance(t.m);
+    edge_based = true;
+    SearchStats s;
+    int64_t start = now_ns();
+
     //initialization
-    u[o_idx] = 0.0;
-    heap->insert(o_idx, u[o_idx]);
-    
-    int vis_idx = 0;
-    
+    u[_o_idx] = 0.0;
+    for (int k = t.out_offset[_o_idx]; k < t.out_offset[_o_idx + 1]; ++k) {
+        int b = t.out_edge[k];
+        u_e[b] = weights[b];
+        heap->insert(b, u_e[b]);
+        open_e[b] = true;
+        s.inserts++;
+    }
+
     while (heap->nItems() > 0)
     {
-        vis_idx = heap->deleteMin();
-        auto vis = g->get_vertex(vis_idx);
-        close[vis_idx] = true;
-        open[vis_idx] = false;
-        auto vis_out = vis->out_edges;
-        for (const auto &e : vis_out)
+        int a = heap->deleteMin();
+        s.delete_mins++;
+        close_e[a] = true;
+        open_e[a] = false;
+        int j = t.head[a];
+        s.vertices_scanned++;
+        s.edges_scanned += t.out_offset[j + 1] - t.out_offset[j];
+        if (u_e[a] < u[j]) {
+            u[j] = u_e[a];
+            last_e[j] = a;
+        }
+        for (int k = t.out_offset[j]; k < t.out_offset[j + 1]; ++k)
         {
-            auto v = e->to_vertex;
-            float dist = 0.0;
-            if (!close[v->idx])
+            int b = t.out_edge[k];
+            if (close_e[b])
+                continue;
+            int turn = find_turn(t, a, b);
+            float penalty = turn < 0 ? 0 : t.turns[turn].penalty;
+            if (penalty == numeric_limits<float>::infinity())
+                continue;
+            float dist = u_e[a] + penalty + weights[b];
+            if (dist < u_e[b])
             {
-                dist = u[vis_idx] + weights[e->idx];
-                
-                if (dist < u[v->idx])
+                u_e[b] = dist;
+                if (open_e[b])
                 {
-                    u[v->idx] = dist;
-                    if (open[v->idx])
-                    {
-                        heap->decreaseKey(v->idx, dist);
-                    }
-                    else
-                    {
-                        heap->insert(v->idx, dist);
-                        open[v->idx] = true;
-                    }
-                    pre_idx[v->idx] = vis_idx;
+                    heap->decreaseKey(b, dist);
+                    s.decrease_keys++;
                 }
+                else
+                {
+                    heap->insert(b, dist);
+                    open_e[b] = true;
+                    s.inserts++;
+                }
+                pre_e[b] = a;
             }
         }
     }
+    s.searches = 1;
+    s.exhausted = 1;
+    s.comparisons = int64_t(heap->nComps());
+    s.search_ns = now_ns() - start;
+    record(s);
     delete heap;
     heap = nullptr;
 }
 
 bp::list Dijkstra::get_path(string _oid, string _did) {
     bp::list path;
-    auto d_idx = g->get_vertex(_did)->idx;
+    auto d_idx = g->get_vidx(_did);
+    if (edge_based) {
+        const int* tail = g->get_topology().tail;
+        int e = last_e[d_idx];
+        path.append(_did);
+        while (e != -1) {
+            path.append(g->get_vid(tail[e]));
+            e = pre_e[e];
+        }
+        path.reverse();
+        if (path[0] != _oid) {
+            const string &s = "ERROR: " + _did + " unaccessible from " + _oid;
+            PyErr_SetString(PyExc_Exception, s.c_str());
+        }
+        return path;
+    }
     int idx = d_idx;
     do {
-        path.append(g->get_vertex(idx)->id);
+        path.append(g->get_vid(idx));
         idx = pre_idx[idx];
     } while (idx != -1);
-    path.reverse();
-    if (path[0] != _oid) {
+    // reversed, the predecessors already lead along the edges towards _oid
+    if (!reverse)
+        path.reverse();
+    if (path[reverse ? bp::len(path) - 1 : 0] != _oid) {
         const string &s = "ERROR: " + _did + " unaccessible from " + _oid;
         PyErr_SetString(PyExc_Exception, s.c_str());
     }
     return path;
 }
+
+Topology Dijkstra::topology(){
+    const Topology &t = g->get_topology();
+    if (!reverse)
+        return t;
+    if (t.turn_cnt > 0) {
+        PyErr_SetString(PyExc_ValueError, "reverse searches don't support turn tables");
+        bp::throw_error_already_set();
+    }
+    return reverse_view(t);
+}
+
+void Dijkstra::set_reverse(bool _reverse){
+    reverse = _reverse;
+}
+
+bool Dijkstra::get_reverse() const{
+    return reverse;
+}
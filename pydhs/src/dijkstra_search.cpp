@@ -0,0 +1,71 @@
+//
+//  dijkstra_search.cpp
+//  MyGraph
+//
+
+#include "dijkstra_search.h"
+#include <limits>
+
+void dijkstra_recover(size_t _n, const DijkstraLabels &_l) {
+    for (size_t i = 0; i < _n; ++i) {
+        _l.u[i] = numeric_limits<float>::infinity();
+        _l.pre_idx[i] = -1;
+        _l.open[i] = false;
+        _l.close[i] = false;
+        _l.last_e[i] = -1;
+    }
+}
+
+void dijkstra_search(const Topology &_t, const float* _weights, int _o_idx, Heap &_heap,
+                     const DijkstraLabels &_l, SearchStats &_s) {
+    float* u = _l.u;
+    bool* open = _l.open;
+    bool* close = _l.close;
+
+    //initialization
+    u[_o_idx] = 0.0;
+    _heap.insert(_o_idx, u[_o_idx]);
+    _s.inserts++;
+
+    int vis_idx = 0;
+
+    while (_heap.nItems() > 0)
+    {
+        vis_idx = _heap.deleteMin();
+        _s.delete_mins++;
+        close[vis_idx] = true;
+        open[vis_idx] = false;
+        _s.vertices_scanned++;
+        _s.edges_scanned += _t.out_offset[vis_idx + 1] - _t.out_offset[vis_idx];
+        for (int k = _t.out_offset[vis_idx]; k < _t.out_offset[vis_idx + 1]; ++k)
+        {
+            int a_idx = _t.out_edge[k];
+            int v_idx = _t.head[a_idx];
+            float dist = 0.0;
+            if (!close[v_idx])
+            {
+                dist = u[vis_idx] + _weights[a_idx];
+
+                if (dist < u[v_idx])
+                {
+                    u[v_idx] = dist;
+                    if (open[v_idx])
+                    {
+                        _heap.decreaseKey(v_idx, dist);
+                        _s.decrease_keys++;
+                    }
+                    else
+                    {
+                        _heap.insert(v_idx, dist);
+                        open[v_idx] = true;
+                        _s.inserts++;
+                    }
+                    _l.pre_idx[v_idx] = vis_idx;
+                }
+            }
+        }
+    }
+    _s.searches++;
+    _s.exhausted++;
+    _s.comparisons += int64_t(_heap.nComps());
+}
@@ -255,8 +255,45 @@ void FHeap::decreaseKey(int item, double newValue)
 #endif
 }
 
+/* --- clear() ---
+ * Deletes all items remaining in the heap, leaving it empty for reuse.  Only
+ * the nodes still in the heap are visited, rather than the whole $nodes$
+ * array.
+ */
+void FHeap::clear()
+{
+    int r;
+    
+    for(r = 0; r < maxTrees; r++) {
+        if(trees[r]) {
+            freeNodes(trees[r]);
+            trees[r] = NULL;
+        }
+    }
+    itemCount = 0;
+    treeSum = 0;
+}
+
 /*--- FHeap (private methods) -----------------------------------------------*/
 
+/* --- freeNodes() ---
+ * Deletes every node in the circularly linked list $treeList$ together with
+ * all of their descendants.
+ */
+void FHeap::freeNodes(FHeapNode *treeList)
+{
+    FHeapNode *nodePtr, *next;
+    
+    nodePtr = treeList;
+    do {
+        next = nodePtr->right;
+        if(nodePtr->rank > 0) freeNodes(nodePtr->child);
+        nodes[nodePtr->item] = NULL;
+        delete nodePtr;
+        nodePtr = next;
+    } while(nodePtr != treeList);
+}
+
 /* --- meld() ---
  * melds the linked list of trees pointed to by $treeList$ into the heap.
  */
@@ -11,41 +11,40 @@
 #include "fibheap.h"
 #include "dijkstra.h"
 #include "heap.h"
+#include "parallel.h"
+#include "pyhelper.h"
+#include "sampler.h"
 #include <algorithm>
+#include <cmath>
+#include <memory>
 #include <sstream>
 
-#define LARGENUMBER 9999999999
-
 Hyperpath::Hyperpath(Graph * const _g) {
     g = _g;
     size_t n = g->get_vertex_number();
     size_t m = g->get_edge_number();
-    u_i = new float[n];
-    f_i = new float[n];
-    p_i = new float[n];
-
-
-    u_a = new float[m];
-    p_a = new float[m];
-    open = new bool[m];
-    close = new bool[m];
 
     h = new float[n];
     wmin = new float[m];
     wmax = new float[m];
+    weight_version = 0;
+    potentials = nullptr;
+    profile_min = nullptr;
+    profile_max = nullptr;
+    ws = new HyperpathWorkspace(n, m);
+    hyperpath_o_idx = 0;
+    hyperpath_cost = numeric_limits<float>::infinity();
+    hyperpath_bound = 0;
+    pruning.eps = 0;
+    pruning.k = 0;
+    reverse = false;
+    gev_theta = 0;
 
     for (unsigned int i = 0; i < n; ++i) {
-        u_i[i] = numeric_limits<float>::infinity();
-        f_i[i] = 0.0;
-        p_i[i] = 0.0;
         h[i] = 0.0;
     }
 
     for (unsigned int i = 0; i < m; ++i) {
-        u_a[i] = numeric_limits<float>::infinity();
-        p_a[i] = 0.0;
-        open[i] = false;
-        close[i] = false;
         wmin[i] = 0.0;
         wmax[i] = 0.0;
     }
@@ -53,36 +52,29 @@ Hyperpath::Hyperpath(Graph * const _g) {
 }
 
 Hyperpath::~Hyperpath() {
-    delete[] u_i;
-    u_i = nullptr;
-    delete[] f_i;
-    f_i = nullptr;
-    delete[] p_i;
-    p_i = nullptr;
-    delete[] u_a;
-    u_a = nullptr;
-    delete[] p_a;
-    p_a = nullptr;
-    delete[] open;
-    open = nullptr;
-    delete[] close;
-    close = nullptr;
-    delete h;
+    delete[] h;
     h = nullptr;
+    delete[] wmin;
     wmin = nullptr;
-    delete wmin;
+    delete[] wmax;
     wmax = nullptr;
-    delete wmax;
+    delete potentials;
+    potentials = nullptr;
+    delete profile_min;
+    profile_min = nullptr;
+    delete profile_max;
+    profile_max = nullptr;
+    delete ws;
+    ws = nullptr;
 }
 
 
 void Hyperpath::set_weights(const bp::object &_wmin, const bp::object &_wmax){
     size_t m = g->get_edge_number();
-    for (unsigned int i=0; i<m; i++){
-        wmin[i] = bp::extract<float>(_wmin[i]);
-        wmax[i] = bp::extract<float>(_wmax[i]);
-    }
-    
+    copy_floats(_wmin, wmin, m);
+    copy_floats(_wmax, wmax, m);
+    weight_version++;
+    trees.clear();
 }
 
 void Hyperpath::set_potentials(const bp::object &_h){
@@ -92,140 +84,445 @@ void Hyperpath::set_potentials(const bp::object &_h){
     }
 }
 
-//   const float * denotes a constant pointer while float * const denotes the pointed content is constant
-//   since we may need to adjust weights_min and weights, the pointed content shouldn't be constant
+// capacity 0 switches back to the potentials given by set_potentials
+void Hyperpath::cache_potentials(int _capacity){
+    delete potentials;
+    potentials = nullptr;
+    if (_capacity > 0)
+        potentials = new PotentialCache(_capacity);
+}
 
-// sf_di, link set overhead
-void Hyperpath::run(const string&_oid, const string& _did) {
+// the backward pass searches towards the origin, so the consistent
+// potential of a vertex is its wmin distance from the origin
+HyperpathWeights Hyperpath::get_weights(const Topology &_t, int _o_idx,
+                                        PotentialCache::Potentials &_cached) {
+    HyperpathWeights w;
+    w.wmin = wmin;
+    w.wmax = wmax;
+    w.h = h;
+    if (potentials != nullptr) {
+        _cached = potentials->get(_t, wmin, weight_version, _o_idx);
+        w.h = _cached->data();
+    }
+    return w;
+}
 
-    HeapD<FHeap> heapD;
-    Heap* heap = heapD.newInstance(g->get_edge_number());
+void Hyperpath::run(const string&_oid, const string& _did) {
     auto o_idx = g->get_vidx(_oid);
     auto d_idx = g->get_vidx(_did);
 
-    //initialization
-    vector<Edge*> po_edges;
-
-    u_i[d_idx] = 0.0;
-    p_i[o_idx] = 1.0;
-
-    int j_idx = d_idx;
-    int i_idx = 0;
-    int a_idx = 0;
-
-    // backward pass
-    while (true) {
-        auto j = g->get_vertex(j_idx);
-        for (const auto &edge : j->in_edges) {
-            a_idx = edge->idx;
-            i_idx = edge->from_vertex->idx;
-            j_idx = edge->to_vertex->idx;
-
-            float temp = u_i[j_idx] + wmin[a_idx] + h[i_idx];
-            if (u_a[a_idx] > temp) {
-                u_a[a_idx] = temp;
-                if (!close[a_idx]) {
-                    if (!open[a_idx]) {
-                        heap->insert(a_idx, u_a[a_idx]);
-                        open[a_idx] = true;
-                    } else {
-                        heap->decreaseKey(a_idx, temp);
-                    }
-                }
-            }
+    const Topology t = topology();
+    if (ws->u_a.size() != size_t(t.m + t.turn_cnt)) {
+        delete ws;
+        ws = new HyperpathWorkspace(t.n, t.m, t.turn_cnt);
+    }
+    PotentialCache::Potentials cached;
+    ws->stats.clear();
+    search(t, get_weights(t, o_idx, cached), o_idx, d_idx, *ws, get_pruning(t));
+    collect(ws->po_edges, o_idx, ws->u_i[o_idx]);
+    record(ws->stats);
+}
+
+// eps and k as in HyperpathPruning, both zero for the exact search
+void Hyperpath::set_approximation(float _eps, int _k) {
+    if (!(_eps >= 0 && _eps <= 1) || _k < 0) {
+        PyErr_SetString(PyExc_ValueError, "eps must be within [0, 1] and k non-negative");
+        bp::throw_error_already_set();
+    }
+    pruning.eps = _eps;
+    pruning.k = _k;
+}
+
+// theta 0 switches back to the Ma2013 possibilities
+void Hyperpath::set_gev(float _theta) {
+    if (!(_theta >= 0)) {
+        PyErr_SetString(PyExc_ValueError, "theta must be non-negative");
+        bp::throw_error_already_set();
+    }
+    gev_theta = _theta;
+}
+
+void Hyperpath::search(const Topology &_t, const HyperpathWeights &_w, int _o_idx, int _d_idx,
+                       HyperpathWorkspace &_ws, const HyperpathPruning* _prune) const {
+    if (gev_theta > 0)
+        hyperpath_gev(_t, _w, gev_theta, _o_idx, _d_idx, _ws);
+    else
+        hyperpath_search(_t, _w, _o_idx, _d_idx, _ws, _prune);
+}
+
+// the pruning of searches; also where turn tables and approximation are
+// refused in GEV mode, before any worker starts
+const HyperpathPruning* Hyperpath::get_pruning(const Topology &_t) const {
+    if (gev_theta > 0 && _t.turn_cnt > 0) {
+        PyErr_SetString(PyExc_ValueError, "GEV probabilities don't support turn tables");
+        bp::throw_error_already_set();
+    }
+    if (pruning.eps == 0 && pruning.k == 0)
+        return nullptr;
+    if (gev_theta > 0) {
+        PyErr_SetString(PyExc_ValueError, "GEV probabilities don't support approximation");
+        bp::throw_error_already_set();
+    }
+    if (_t.turn_cnt > 0) {
+        PyErr_SetString(PyExc_ValueError, "approximation doesn't support turn tables");
+        bp::throw_error_already_set();
+    }
+    return &pruning;
+}
+
+void Hyperpath::set_profile(const bp::object &_wmin, const bp::object &_wmax,
+                            float _t0, float _bin_width, bool _linear) {
+    size_t m = g->get_edge_number();
+    int bins_min = 0;
+    int bins_max = 0;
+    vector<float> vmin = to_matrix(_wmin, m, bins_min);
+    vector<float> vmax = to_matrix(_wmax, m, bins_max);
+    if (bins_min != bins_max || !(_bin_width > 0)) {
+        PyErr_SetString(PyExc_ValueError, "wmin and wmax need the same positive bins");
+        bp::throw_error_already_set();
+    }
+    delete profile_min;
+    delete profile_max;
+    profile_min = new TimeProfile(m, bins_min, _t0, _bin_width, _linear, vmin);
+    profile_max = new TimeProfile(m, bins_max, _t0, _bin_width, _linear, vmax);
+}
+
+// The earliest arrivals over wmin give the time each edge is entered at, at
+// which both its weights are taken. The arrivals, as travel times, are also
+// consistent potentials for those weights. Edges out of vertices the origin
+// can't reach stay out of the search through their infinite potential.
+void Hyperpath::run_at(const string& _oid, const string& _did, float _time) {
+    auto o_idx = g->get_vidx(_oid);
+    auto d_idx = g->get_vidx(_did);
+    if (profile_min == nullptr || reverse) {
+        PyErr_SetString(PyExc_ValueError, profile_min == nullptr ?
+                        "no profile set, call set_profile first" :
+                        "run_at doesn't support reverse searches");
+        bp::throw_error_already_set();
+    }
+    const Topology t = topology();
+    if (ws->u_a.size() != size_t(t.m + t.turn_cnt)) {
+        delete ws;
+        ws = new HyperpathWorkspace(t.n, t.m, t.turn_cnt);
+    }
+    vector<float> arrival(t.n);
+    vector<float> w_min(t.m, 0.0);
+    vector<float> w_max(t.m, 0.0);
+    ws->stats.clear();
+    int64_t start = now_ns();
+    td_arrivals(t, *profile_min, o_idx, _time, arrival.data(), nullptr);
+    for (int i = 0; i < t.n; ++i) {
+        if (arrival[i] == numeric_limits<float>::infinity())
+            continue;
+        for (int k = t.out_offset[i]; k < t.out_offset[i + 1]; ++k) {
+            int a_idx = t.out_edge[k];
+            w_min[a_idx] = profile_min->at(a_idx, _time + arrival[i]);
+            w_max[a_idx] = profile_max->at(a_idx, _time + arrival[i]);
         }
+    }
+    ws->stats.search_ns += now_ns() - start; // the arrivals are part of the labelling
+    HyperpathWeights w;
+    w.wmin = w_min.data();
+    w.wmax = w_max.data();
+    w.h = arrival.data();
+    search(t, w, o_idx, d_idx, *ws, get_pruning(t));
+    collect(ws->po_edges, o_idx, ws->u_i[o_idx]);
+    record(ws->stats);
+}
 
-        if (0 == heap->nItems()) {
-            break;
-        } else {
-            a_idx = heap->deleteMin();
+void Hyperpath::collect(const vector<int> &_po_edges, int _o_idx, float _cost) {
+    int64_t start = now_ns();
+    hyperpath_o_idx = _o_idx;
+    hyperpath_cost = _cost;
+    hyperpath_bound = ws->bound;
+    hyperpath_edges.clear();
+    hyperpath_probs.clear();
+    for (const auto &a_idx : _po_edges) {
+        if (ws->p_a[a_idx] != 0) {
+            hyperpath_edges.push_back(a_idx);
+            hyperpath_probs.push_back(ws->p_a[a_idx]);
         }
-        open[a_idx] = false;
-        close[a_idx] = true;
-        i_idx = g->get_edge(a_idx)->from_vertex->idx;
-        j_idx = g->get_edge(a_idx)->to_vertex->idx;
-        //updating
-        float w_max = wmax[a_idx];
-        float w_min = wmin[a_idx];
-
-        if (u_i[i_idx] >= u_i[j_idx] + w_min) {
-            float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
-            float P_a = f_a / (f_i[i_idx] + f_a);
-
-            if (f_i[i_idx] == 0) {
-                u_i[i_idx] = u_i[j_idx] + w_max;
-            } else {
-                if (u_i[i_idx]
-                        > (1 - P_a) * u_i[i_idx] + P_a * (u_i[j_idx] + w_min))
-                    u_i[i_idx] = (1 - P_a) * u_i[i_idx]
-                        + P_a * (u_i[j_idx] + w_min);
-            }
+    }
+    ws->stats.output_ns += now_ns() - start;
+}
 
-            f_i[i_idx] += f_a;
-            po_edges.push_back(g->get_edge(a_idx)); //hyperpath is saved by id index of links
+Topology Hyperpath::topology() const {
+    const Topology &t = g->get_topology();
+    if (!reverse)
+        return t;
+    if (t.turn_cnt > 0) {
+        PyErr_SetString(PyExc_ValueError, "reverse searches don't support turn tables");
+        bp::throw_error_already_set();
+    }
+    return reverse_view(t);
+}
 
-        }
+// trees and cached potentials belong to one direction
+void Hyperpath::set_reverse(bool _reverse) {
+    if (_reverse == reverse)
+        return;
+    reverse = _reverse;
+    trees.clear();
+    if (potentials != nullptr)
+        potentials->clear();
+}
 
-        if (u_i[j_idx] + w_min + h[i_idx] > u_i[o_idx])
-            break;
-        j_idx = i_idx;
+bool Hyperpath::get_reverse() const {
+    return reverse;
+}
 
+void Hyperpath::check_no_turns(const Topology &_t, const char* _what) const {
+    if (_t.turn_cnt > 0) {
+        const string msg = string(_what) + " don't support turn tables, use run or run_many";
+        PyErr_SetString(PyExc_ValueError, msg.c_str());
+        bp::throw_error_already_set();
     }
+}
 
-    // forward pass
-    sort(po_edges.begin(), po_edges.end(),
-            [&](Edge* a, Edge* b)->bool
-            {
-            return u_i[a->to_vertex->idx] + wmin[a->idx] > u_i[b->to_vertex->idx] + wmin[b->idx];
-            });
+// full backward pass for _d_idx, replacing a tree computed before
+void Hyperpath::build_tree(int _d_idx) {
+    check_no_turns(topology());
+    shared_ptr<HyperpathTree> tree = make_shared<HyperpathTree>();
+    HyperpathWeights w;
+    w.wmin = wmin;
+    w.wmax = wmax;
+    w.h = nullptr;
+    hyperpath_tree(topology(), w, _d_idx, *ws, *tree);
+    trees[_d_idx] = tree;
+}
+
+void Hyperpath::run_tree(const string& _did) {
+    auto d_idx = g->get_vidx(_did);
+    ws->stats.clear();
+    build_tree(d_idx);
+    record(ws->stats);
+}
+
+// forward pass only, the tree of _did is built on first use
+void Hyperpath::load(const string& _oid, const string& _did) {
+    auto o_idx = g->get_vidx(_oid);
+    auto d_idx = g->get_vidx(_did);
+    check_no_turns(topology());
+    ws->stats.clear();
+    if (trees.find(d_idx) == trees.end())
+        build_tree(d_idx);
+    const HyperpathTree &tree = *trees[d_idx];
+    // the forward pass reads no potentials, none are computed or cached
+    HyperpathWeights w;
+    w.wmin = wmin;
+    w.wmax = wmax;
+    w.h = nullptr;
+    hyperpath_load(topology(), w, tree, o_idx, *ws);
+    collect(tree.po_edges, o_idx, tree.u_i[o_idx]);
+    record(ws->stats);
+}
 
-    for (const auto &po_edge : po_edges) {
-        auto a_idx = po_edge->idx;
-        auto i_idx = po_edge->from_vertex->idx;
-        auto j_idx = po_edge->to_vertex->idx;
-        float w_max = wmax[a_idx];
-        float w_min = wmin[a_idx];
-        float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
-        float P_a = f_a / f_i[i_idx];
-        p_a[a_idx] = P_a * p_i[i_idx];
-        p_i[j_idx] += p_a[a_idx];
+// writes the new weights of a few edges and repairs the retained trees they
+// affect, the others keep serving load as they are
+int Hyperpath::update_weights(const bp::object &_edges, const bp::object &_wmin,
+                              const bp::object &_wmax) {
+    if (!trees.empty())
+        check_no_turns(topology());
+    size_t k = bp::len(_edges);
+    int m = g->get_edge_number();
+    vector<int> edges(k);
+    vector<float> old_wmin(k);
+    for (size_t i = 0; i < k; ++i) {
+        edges[i] = bp::extract<int>(_edges[i]);
+        if (edges[i] < 0 || edges[i] >= m) {
+            PyErr_SetString(PyExc_IndexError, "edge index out of range");
+            bp::throw_error_already_set();
+        }
+    }
+    for (size_t i = 0; i < k; ++i) {
+        old_wmin[i] = wmin[edges[i]];
+        wmin[edges[i]] = bp::extract<float>(_wmin[i]);
+        wmax[edges[i]] = bp::extract<float>(_wmax[i]);
+    }
+    weight_version++;
+
+    const Topology t = topology();
+    HyperpathWeights w;
+    w.wmin = wmin;
+    w.wmax = wmax;
+    w.h = nullptr;
+    int repaired = 0;
+    ws->stats.clear();
+    for (auto &tree : trees) {
+        shared_ptr<HyperpathTree> r = make_shared<HyperpathTree>();
+        if (hyperpath_repair(t, w, edges, old_wmin, *tree.second, *ws, *r)) {
+            tree.second = r;
+            repaired++;
+        }
     }
+    if (repaired > 0)
+        record(ws->stats);
+    return repaired;
+}
+
+// u_i of every vertex in the tree of _did, inf where _did isn't reachable
+np::ndarray Hyperpath::get_tree_costs(const string& _did) {
+    auto d_idx = g->get_vidx(_did);
+    if (trees.find(d_idx) == trees.end()) {
+        ws->stats.clear();
+        build_tree(d_idx);
+        record(ws->stats);
+    }
+    return to_ndarray(trees[d_idx]->u_i);
+}
 
-    for (const auto &po_edge : po_edges) {
-        if (p_a[po_edge->idx] != 0)
-            hyperpath.push_back(make_pair(po_edge->id, p_a[po_edge->idx]));
+void Hyperpath::clear_trees() {
+    trees.clear();
+}
+
+// every worker keeps its own workspace and output buffers; the per OD slices
+// are stitched together in OD order once all workers are done
+bp::tuple Hyperpath::run_many(const bp::object &_oids, const bp::object &_dids, int _threads) {
+    vector<int> o_idx = to_vidx(g, _oids);
+    vector<int> d_idx = to_vidx(g, _dids);
+    if (o_idx.size() != d_idx.size()) {
+        PyErr_SetString(PyExc_ValueError, "origins and destinations differ in length");
+        bp::throw_error_already_set();
+    }
+    size_t k = o_idx.size();
+    size_t n = g->get_vertex_number();
+    size_t m = g->get_edge_number();
+    const Topology t = topology();
+    int workers = worker_count(_threads, k);
+    const HyperpathPruning* prune = get_pruning(t);
+
+    vector<unique_ptr<HyperpathWorkspace> > spaces;
+    for (int w = 0; w < workers; ++w)
+        spaces.push_back(unique_ptr<HyperpathWorkspace>(new HyperpathWorkspace(n, m, t.turn_cnt)));
+    vector<vector<int> > edge_buf(workers);
+    vector<vector<float> > prob_buf(workers);
+    vector<int> od_worker(k);
+    vector<size_t> od_begin(k);
+    vector<size_t> od_end(k);
+    vector<float> od_cost(k);
+
+    {
+        ScopedGILRelease nogil;
+        parallel_for(k, workers, [&](int w, size_t i) {
+            HyperpathWorkspace &space = *spaces[w];
+            PotentialCache::Potentials cached;
+            search(t, get_weights(t, o_idx[i], cached), o_idx[i], d_idx[i], space, prune);
+            int64_t start = now_ns();
+            od_worker[i] = w;
+            od_cost[i] = space.u_i[o_idx[i]];
+            od_begin[i] = edge_buf[w].size();
+            for (const auto &a_idx : space.po_edges) {
+                if (space.p_a[a_idx] != 0) {
+                    edge_buf[w].push_back(a_idx);
+                    prob_buf[w].push_back(space.p_a[a_idx]);
+                }
+            }
+            od_end[i] = edge_buf[w].size();
+            space.stats.output_ns += now_ns() - start;
+        });
+    }
+    SearchStats batch;
+    for (const auto &space : spaces)
+        batch.add(space->stats);
+    int64_t start = now_ns();
+
+    vector<int64_t> od_offsets(k + 1, 0);
+    for (size_t i = 0; i < k; ++i)
+        od_offsets[i + 1] = od_offsets[i] + (od_end[i] - od_begin[i]);
+    vector<int> edge_idx(od_offsets[k]);
+    vector<float> prob(od_offsets[k]);
+    for (size_t i = 0; i < k; ++i) {
+        const int w = od_worker[i];
+        copy(edge_buf[w].begin() + od_begin[i], edge_buf[w].begin() + od_end[i],
+             edge_idx.begin() + od_offsets[i]);
+        copy(prob_buf[w].begin() + od_begin[i], prob_buf[w].begin() + od_end[i],
+             prob.begin() + od_offsets[i]);
     }
+    bp::tuple out = bp::make_tuple(to_ndarray(od_offsets), to_ndarray(edge_idx), to_ndarray(prob),
+                                   to_ndarray(od_cost));
+    batch.output_ns += now_ns() - start;
+    record(batch);
+    return out;
+}
 
-    delete heap;
-    heap = nullptr;
+// _k routes drawn along the hyperpath of run(_oid, _did), returned as
+// (offsets, edge indices) with the edges of route r at offsets[r]..offsets[r+1]
+bp::tuple Hyperpath::sample_routes(const string& _oid, const string& _did, int _k,
+                                   unsigned long _seed) {
+    // the next edge is drawn by vertex, regardless of the edge arrived over
+    check_no_turns(topology(), "sampled routes");
+    run(_oid, _did);
+    auto o_idx = g->get_vidx(_oid);
+    auto d_idx = g->get_vidx(_did);
+    vector<int64_t> offsets(1, 0);
+    vector<int> route_edges;
+    const Topology t = topology();
+    {
+        ScopedGILRelease nogil;
+        RouteSampler sampler(t, hyperpath_edges, hyperpath_probs);
+        SplitMix64 rng(_seed);
+        for (int r = 0; r < _k; ++r) {
+            sampler.sample(o_idx, d_idx, rng, route_edges);
+            offsets.push_back(route_edges.size());
+        }
+    }
+    return bp::make_tuple(to_ndarray(offsets), to_ndarray(route_edges));
 }
 
 bp::list Hyperpath::get_hyperpath() {
     bp::list l;
-    for (auto it = hyperpath.begin(); it != hyperpath.end(); it++) {
-        bp::tuple e = bp::make_tuple((*it).first, (*it).second);
+    for (size_t i = 0; i < hyperpath_edges.size(); ++i) {
+        bp::tuple e = bp::make_tuple(g->get_eid(hyperpath_edges[i]), hyperpath_probs[i]);
         l.append(e);
     }
     return l;
 }
 
-void Hyperpath::recover(){
-    size_t n = g->get_vertex_number();
-    size_t m = g->get_edge_number();
+np::ndarray Hyperpath::get_edges() const {
+    return to_ndarray(hyperpath_edges);
+}
 
-    for (unsigned int i = 0; i < n; ++i) {
-        u_i[i] = numeric_limits<float>::infinity();
-        f_i[i] = 0.0;
-        p_i[i] = 0.0;
-    }
+np::ndarray Hyperpath::get_probs() const {
+    return to_ndarray(hyperpath_probs);
+}
 
-    for (unsigned int i = 0; i < m; ++i) {
-        u_a[i] = numeric_limits<float>::infinity();
-        p_a[i] = 0.0;
-        open[i] = false;
-        close[i] = false;
+float Hyperpath::get_cost() const {
+    return hyperpath_cost;
+}
+
+float Hyperpath::get_error_bound() const {
+    return hyperpath_bound;
+}
+
+// p_i of the visited vertices, summed up from the edge possibilities so that
+// it costs nothing unless asked for
+bp::tuple Hyperpath::get_node_probs() const {
+    const int* head = topology().head;
+    vector<pair<int, float> > visits;
+    if (!hyperpath_edges.empty() || hyperpath_cost == 0)
+        visits.push_back(make_pair(hyperpath_o_idx, 1.0f));
+    for (size_t i = 0; i < hyperpath_edges.size(); ++i)
+        visits.push_back(make_pair(head[hyperpath_edges[i]], hyperpath_probs[i]));
+    sort(visits.begin(), visits.end(),
+         [](const pair<int, float> &a, const pair<int, float> &b) { return a.first < b.first; });
+    vector<int> vertices;
+    vector<float> probs;
+    for (const auto &v : visits) {
+        if (!vertices.empty() && vertices.back() == v.first) {
+            probs.back() += v.second;
+        } else {
+            vertices.push_back(v.first);
+            probs.push_back(v.second);
+        }
     }
+    return bp::make_tuple(to_ndarray(vertices), to_ndarray(probs));
+}
 
-    hyperpath.clear();
+void Hyperpath::recover(){
+    ws->recover();
+    hyperpath_edges.clear();
+    hyperpath_probs.clear();
+    hyperpath_cost = numeric_limits<float>::infinity();
+    hyperpath_bound = 0;
     path_rec.clear();
 }
@@ -0,0 +1,681 @@
+//
+//  hyperpath_search.cpp
+//  MyGraph
+//
+
+#include "hyperpath_search.h"
+#include <algorithm>
+#include <cmath>
+
+#define LARGENUMBER 9999999999
+
+HyperpathWorkspace::HyperpathWorkspace(size_t n, size_t m, size_t turns)
+    : u_i(n, numeric_limits<float>::infinity()), f_i(n, 0.0), p_i(n, 0.0),
+      u_e(turns > 0 ? m : 0, numeric_limits<float>::infinity()), f_e(turns > 0 ? m : 0, 0.0),
+      u_a(m + turns, numeric_limits<float>::infinity()), p_a(m + turns, 0.0),
+      open(m + turns, false), close(m + turns, false), heap(m + turns), bound(0) {
+}
+
+// adds the time of _f to _ns
+template <class F>
+static inline void timed(int64_t &_ns, F _f) {
+    int64_t start = now_ns();
+    _f();
+    _ns += now_ns() - start;
+}
+
+// runs the label setting _pass, adding its time and heap comparisons to the
+// stats of _ws
+template <class F>
+static inline void timed_search(HyperpathWorkspace &_ws, F _pass) {
+    double comparisons = _ws.heap.nComps();
+    timed(_ws.stats.search_ns, _pass);
+    _ws.stats.comparisons += int64_t(_ws.heap.nComps() - comparisons);
+}
+
+void HyperpathWorkspace::recover() {
+    for (const auto &i : touched_vertices) {
+        u_i[i] = numeric_limits<float>::infinity();
+        f_i[i] = 0.0;
+        p_i[i] = 0.0;
+    }
+    if (!v_i.empty()) {
+        for (const auto &i : touched_vertices) {
+            v_i[i] = numeric_limits<float>::infinity();
+            g_i[i] = 0.0;
+            k_i[i] = 0;
+        }
+    }
+    if (!m_i.empty()) {
+        for (const auto &i : touched_vertices) {
+            m_i[i] = numeric_limits<float>::infinity();
+            s_i[i] = 0.0;
+        }
+    }
+    for (const auto &a : touched_edges) {
+        u_a[a] = numeric_limits<float>::infinity();
+        p_a[a] = 0.0;
+        open[a] = false;
+        close[a] = false;
+        if (size_t(a) < u_e.size()) {
+            u_e[a] = numeric_limits<float>::infinity();
+            f_e[a] = 0.0;
+        }
+    }
+    touched_vertices.clear();
+    touched_edges.clear();
+    po_edges.clear();
+    po_from.clear();
+    heap.clear();
+    bound = 0;
+}
+
+//   const float * denotes a constant pointer while float * const denotes the pointed content is constant
+//   since we may need to adjust weights_min and weights, the pointed content shouldn't be constant
+
+// lowers the key of heap item _a_idx to _key unless it is settled
+static inline void push_item(int _a_idx, float _key, HyperpathWorkspace &_ws) {
+    float* u_a = _ws.u_a.data();
+    if (u_a[_a_idx] > _key) {
+        if (u_a[_a_idx] == numeric_limits<float>::infinity())
+            _ws.touched_edges.push_back(_a_idx);
+        u_a[_a_idx] = _key;
+        if (!_ws.close[_a_idx]) {
+            if (!_ws.open[_a_idx]) {
+                _ws.heap.insert(_a_idx, _key);
+                _ws.open[_a_idx] = true;
+                _ws.stats.inserts++;
+            } else {
+                _ws.heap.decreaseKey(_a_idx, _key);
+                _ws.stats.decrease_keys++;
+            }
+        }
+    }
+}
+
+// pushes the in-edges of _j_idx onto the heap with key u_i[j] + wmin + h[i]
+static inline void relax_in_edges(const Topology &_t, const HyperpathWeights &_w,
+                                  int _j_idx, HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* h = _w.h;
+
+    _ws.stats.vertices_scanned++;
+    _ws.stats.edges_scanned += _t.in_offset[_j_idx + 1] - _t.in_offset[_j_idx];
+    for (int k = _t.in_offset[_j_idx]; k < _t.in_offset[_j_idx + 1]; ++k) {
+        int a_idx = _t.in_edge[k];
+        int i_idx = _t.tail[a_idx];
+        push_item(a_idx, _ws.u_i[_j_idx] + wmin[a_idx] + (h ? h[i_idx] : 0), _ws);
+    }
+}
+
+// settles the edges on the heap by increasing key, updating u_i and f_i of
+// their tails and appending the attractive ones to po_edges. It stops once no
+// remaining edge can improve the label of _o_idx, or runs to completion when
+// _o_idx is -1.
+static void settle(const Topology &_t, const HyperpathWeights &_w,
+                   int _o_idx, HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* wmax = _w.wmax;
+    const float* h = _w.h;
+    float* u_i = _ws.u_i.data();
+    float* f_i = _ws.f_i.data();
+    char* open = _ws.open.data();
+    char* close = _ws.close.data();
+    FHeap &heap = _ws.heap;
+    vector<int> &po_edges = _ws.po_edges;
+
+    while (0 != heap.nItems()) {
+        int a_idx = heap.deleteMin();
+        _ws.stats.delete_mins++;
+        open[a_idx] = false;
+        close[a_idx] = true;
+        int i_idx = _t.tail[a_idx];
+        int j_idx = _t.head[a_idx];
+        //updating
+        float w_max = wmax[a_idx];
+        float w_min = wmin[a_idx];
+
+        if (u_i[i_idx] >= u_i[j_idx] + w_min) {
+            float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
+            float P_a = f_a / (f_i[i_idx] + f_a);
+
+            if (f_i[i_idx] == 0) {
+                u_i[i_idx] = u_i[j_idx] + w_max;
+                _ws.touched_vertices.push_back(i_idx);
+            } else {
+                if (u_i[i_idx]
+                        > (1 - P_a) * u_i[i_idx] + P_a * (u_i[j_idx] + w_min))
+                    u_i[i_idx] = (1 - P_a) * u_i[i_idx]
+                        + P_a * (u_i[j_idx] + w_min);
+            }
+
+            f_i[i_idx] += f_a;
+            po_edges.push_back(a_idx); //hyperpath is saved by id index of links
+
+        }
+
+        if (_o_idx >= 0 && u_i[j_idx] + w_min + (h ? h[i_idx] : 0) > u_i[_o_idx]) {
+            _ws.stats.stopped_at_origin++;
+            return;
+        }
+        relax_in_edges(_t, _w, i_idx, _ws);
+    }
+    _ws.stats.exhausted++;
+}
+
+// backward pass from _d_idx, leaving u_i, f_i and the attractive edges in _ws.
+// sf_di, link set overhead
+static void backward_pass(const Topology &_t, const HyperpathWeights &_w,
+                          int _o_idx, int _d_idx, HyperpathWorkspace &_ws) {
+    //initialization
+    _ws.u_i[_d_idx] = 0.0;
+    _ws.touched_vertices.push_back(_d_idx);
+    relax_in_edges(_t, _w, _d_idx, _ws);
+    settle(_t, _w, _o_idx, _ws);
+}
+
+// offers the edge _b_idx, reached at cost _u_j + _penalty beyond its head, to
+// a label _u / _f; returns true when the edge is attractive
+static inline bool offer(const HyperpathWeights &_w, int _b_idx, float _u_j,
+                         float &_u, float &_f) {
+    float w_max = _w.wmax[_b_idx];
+    float w_min = _w.wmin[_b_idx];
+    if (!(_u >= _u_j + w_min))
+        return false;
+    float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
+    float P_a = f_a / (_f + f_a);
+    if (_f == 0) {
+        _u = _u_j + w_max;
+    } else {
+        if (_u > (1 - P_a) * _u + P_a * (_u_j + w_min))
+            _u = (1 - P_a) * _u + P_a * (_u_j + w_min);
+    }
+    _f += f_a;
+    return true;
+}
+
+// backward pass cutting the choice sets by _prune. Next to the pruned labels
+// u_i, v_i takes every edge offered, given the same pruned labels downstream,
+// so u_i - v_i is what pruning at i alone costs. An exact strategy visits a
+// vertex at most once, which bounds the error of u_i[o] by the sum B of these
+// over all labelled vertices (performance difference of the two strategies).
+// For the sum to cover every vertex of the exact hyperpath, whose keys may be
+// raised by up to B through the pruned labels, the pass runs on until the
+// keys exceed u_i[o] + B rather than u_i[o].
+static void pruned_backward_pass(const Topology &_t, const HyperpathWeights &_w,
+                                 const HyperpathPruning &_prune, int _o_idx, int _d_idx,
+                                 HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* wmax = _w.wmax;
+    const float* h = _w.h;
+    if (_ws.v_i.size() != size_t(_t.n)) {
+        _ws.v_i.assign(_t.n, numeric_limits<float>::infinity());
+        _ws.g_i.assign(_t.n, 0.0);
+        _ws.k_i.assign(_t.n, 0);
+    }
+    float* u_i = _ws.u_i.data();
+    float* f_i = _ws.f_i.data();
+    float* v_i = _ws.v_i.data();
+    float* g_i = _ws.g_i.data();
+    int* k_i = _ws.k_i.data();
+    FHeap &heap = _ws.heap;
+    double bound = 0;
+
+    //initialization
+    u_i[_d_idx] = 0.0;
+    v_i[_d_idx] = 0.0;
+    _ws.touched_vertices.push_back(_d_idx);
+    relax_in_edges(_t, _w, _d_idx, _ws);
+
+    bool stopped = false;
+    while (0 != heap.nItems()) {
+        int a_idx = heap.deleteMin();
+        _ws.stats.delete_mins++;
+        _ws.open[a_idx] = false;
+        _ws.close[a_idx] = true;
+        int i_idx = _t.tail[a_idx];
+        int j_idx = _t.head[a_idx];
+        float u_j = u_i[j_idx];
+        float loss = f_i[i_idx] > 0 ? u_i[i_idx] - v_i[i_idx] : 0;
+
+        offer(_w, a_idx, u_j, v_i[i_idx], g_i[i_idx]);
+        if (u_i[i_idx] >= u_j + wmin[a_idx]) {
+            float f_a = wmax[a_idx] == wmin[a_idx] ? LARGENUMBER : 1.0 / (wmax[a_idx] - wmin[a_idx]);
+            // the first edge is always kept, the vertex stays reachable
+            bool keep = f_i[i_idx] == 0
+                || ((_prune.k <= 0 || k_i[i_idx] < _prune.k)
+                    && f_a / (f_i[i_idx] + f_a) >= _prune.eps);
+            if (keep) {
+                if (f_i[i_idx] == 0)
+                    _ws.touched_vertices.push_back(i_idx);
+                offer(_w, a_idx, u_j, u_i[i_idx], f_i[i_idx]);
+                k_i[i_idx]++;
+                _ws.po_edges.push_back(a_idx);
+            }
+        }
+        if (f_i[i_idx] > 0)
+            bound += (u_i[i_idx] - v_i[i_idx]) - loss;
+
+        if (_o_idx >= 0 && u_j + wmin[a_idx] + (h ? h[i_idx] : 0) > u_i[_o_idx] + bound) {
+            stopped = true;
+            break;
+        }
+        relax_in_edges(_t, _w, i_idx, _ws);
+    }
+    (stopped ? _ws.stats.stopped_at_origin : _ws.stats.exhausted)++;
+    _ws.bound = max(0.0, bound);
+}
+
+// backward pass with turn tables. Besides the vertex labels u_i of starting
+// at a vertex, u_e labels arriving at the head of an edge, and the heap
+// item of edge b is keyed u_e[b] + wmin + h at its tail. Settling it offers b
+// to the tail and to the edges turning freely into b; a listed turn joins the
+// heap as item m + k with its penalty added and is offered once settled.
+// Restricted turns are never offered.
+static void turn_backward_pass(const Topology &_t, const HyperpathWeights &_w,
+                               int _o_idx, int _d_idx, HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* h = _w.h;
+    float* u_i = _ws.u_i.data();
+    float* f_i = _ws.f_i.data();
+    float* u_e = _ws.u_e.data();
+    float* f_e = _ws.f_e.data();
+    float* u_a = _ws.u_a.data();
+    FHeap &heap = _ws.heap;
+    const int m = _t.m;
+
+    //initialization, arriving at _d_idx over any edge ends the trip
+    u_i[_d_idx] = 0.0;
+    _ws.touched_vertices.push_back(_d_idx);
+    for (int k = _t.in_offset[_d_idx]; k < _t.in_offset[_d_idx + 1]; ++k) {
+        int a_idx = _t.in_edge[k];
+        u_e[a_idx] = 0.0;
+        push_item(a_idx, wmin[a_idx] + (h ? h[_t.tail[a_idx]] : 0), _ws);
+    }
+
+    while (0 != heap.nItems()) {
+        int x = heap.deleteMin();
+        _ws.stats.delete_mins++;
+        _ws.open[x] = false;
+        _ws.close[x] = true;
+        float key = u_a[x];
+
+        if (x < m) {
+            int b_idx = x;
+            int i_idx = _t.tail[b_idx];
+            if (i_idx != _d_idx) {
+                _ws.stats.vertices_scanned++;
+                _ws.stats.edges_scanned += _t.in_offset[i_idx + 1] - _t.in_offset[i_idx];
+                if (offer(_w, b_idx, u_e[b_idx], u_i[i_idx], f_i[i_idx])) {
+                    _ws.touched_vertices.push_back(i_idx);
+                    _ws.po_edges.push_back(b_idx);
+                    _ws.po_from.push_back(-1);
+                }
+                for (int k = _t.in_offset[i_idx]; k < _t.in_offset[i_idx + 1]; ++k) {
+                    int a_idx = _t.in_edge[k];
+                    int turn = find_turn(_t, a_idx, b_idx);
+                    if (turn >= 0) {
+                        float penalty = _t.turns[turn].penalty;
+                        if (penalty != numeric_limits<float>::infinity())
+                            push_item(m + turn, key + penalty, _ws);
+                    } else if (offer(_w, b_idx, u_e[b_idx], u_e[a_idx], f_e[a_idx])) {
+                        _ws.po_edges.push_back(b_idx);
+                        _ws.po_from.push_back(a_idx);
+                        push_item(a_idx, u_e[a_idx] + wmin[a_idx] + (h ? h[_t.tail[a_idx]] : 0), _ws);
+                    }
+                }
+            }
+        } else {
+            const Turn &turn = _t.turns[x - m];
+            int a_idx = turn.from_idx;
+            int b_idx = turn.to_idx;
+            if (offer(_w, b_idx, u_e[b_idx] + turn.penalty, u_e[a_idx], f_e[a_idx])) {
+                _ws.po_edges.push_back(b_idx);
+                _ws.po_from.push_back(a_idx);
+                push_item(a_idx, u_e[a_idx] + wmin[a_idx] + (h ? h[_t.tail[a_idx]] : 0), _ws);
+            }
+        }
+
+        if (_o_idx >= 0 && key > u_i[_o_idx]) {
+            _ws.stats.stopped_at_origin++;
+            return;
+        }
+    }
+    _ws.stats.exhausted++;
+}
+
+// orders the attractive edges for loading, tails before heads, by
+// decreasing _key: u_i[j] + wmin, or with turn tables u_e + wmin of the edge,
+// keeping _po_from alongside. The backward pass settles edges by increasing
+// key + h[i], so without potentials every attractive edge out of a vertex is
+// settled before those into it and reversing the settle order does in linear
+// time. With potentials an edge into a vertex may settle before one out of
+// it: inconsistent ones allow a lower key, even exact ones an equal key,
+// which integer weights make common. The edges are sorted then.
+template <class K>
+static void loading_order(const HyperpathWeights &_w, K _key, vector<int> &_po_edges,
+                          vector<int>* _po_from = nullptr) {
+    if (!_w.h) {
+        reverse(_po_edges.begin(), _po_edges.end());
+        if (_po_from)
+            reverse(_po_from->begin(), _po_from->end());
+        return;
+    }
+    if (!_po_from) {
+        sort(_po_edges.begin(), _po_edges.end(),
+                [&](int a, int b)->bool
+                {
+                return _key(a) > _key(b);
+                });
+        return;
+    }
+    vector<int> order(_po_edges.size());
+    for (size_t k = 0; k < order.size(); ++k)
+        order[k] = int(k);
+    sort(order.begin(), order.end(),
+            [&](int a, int b)->bool
+            {
+            return _key(_po_edges[a]) > _key(_po_edges[b]);
+            });
+    vector<int> edges(order.size());
+    vector<int> from(order.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        edges[k] = _po_edges[order[k]];
+        from[k] = (*_po_from)[order[k]];
+    }
+    _po_edges.swap(edges);
+    _po_from->swap(from);
+}
+
+// loading order of the attractive edges of a backward pass in _ws
+static void loading_order(const Topology &_t, const HyperpathWeights &_w,
+                          HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    if (_t.turn_cnt > 0) {
+        const float* u_e = _ws.u_e.data();
+        loading_order(_w, [&](int a) { return u_e[a] + wmin[a]; }, _ws.po_edges, &_ws.po_from);
+    } else {
+        const float* u_i = _ws.u_i.data();
+        loading_order(_w, [&](int a) { return u_i[_t.head[a]] + wmin[a]; }, _ws.po_edges);
+    }
+}
+
+// puts _volume units of flow on _o_idx before the forward pass
+static void seed(int _o_idx, float _volume, HyperpathWorkspace &_ws) {
+    _ws.p_i[_o_idx] += _volume;
+    _ws.touched_vertices.push_back(_o_idx);
+}
+
+// forward pass loading the seeded flow onto _po_edges, given in loading
+// order, leaving p_i and p_a in _ws. Loading is linear, so flows seeded on
+// several origins are carried in one pass.
+static void forward_pass(const Topology &_t, const HyperpathWeights &_w,
+                         const float* _f_i, const vector<int> &_po_edges,
+                         HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* wmax = _w.wmax;
+    float* p_i = _ws.p_i.data();
+    float* p_a = _ws.p_a.data();
+
+    for (const auto &a_idx : _po_edges) {
+        auto i_idx = _t.tail[a_idx];
+        auto j_idx = _t.head[a_idx];
+        if (p_i[i_idx] == 0)
+            continue;
+        float w_max = wmax[a_idx];
+        float w_min = wmin[a_idx];
+        float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
+        float P_a = f_a / _f_i[i_idx];
+        p_a[a_idx] = P_a * p_i[i_idx];
+        _ws.touched_edges.push_back(a_idx);
+        _ws.touched_vertices.push_back(j_idx);
+        p_i[j_idx] += p_a[a_idx];
+    }
+}
+
+// forward pass with turn tables over po_edges/po_from in loading order. The
+// flow arriving over edge a is p_a[a] and is split by f_e[a], flow starting
+// at a vertex by f_i. po_edges is left holding the loaded edges, once each.
+static void turn_forward_pass(const Topology &_t, const HyperpathWeights &_w,
+                              HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* wmax = _w.wmax;
+    float* p_i = _ws.p_i.data();
+    float* p_a = _ws.p_a.data();
+    vector<int> loaded;
+
+    for (size_t k = 0; k < _ws.po_edges.size(); ++k) {
+        int b_idx = _ws.po_edges[k];
+        int a_idx = _ws.po_from[k];
+        float p = a_idx < 0 ? p_i[_t.tail[b_idx]] : p_a[a_idx];
+        if (p == 0)
+            continue;
+        float f = a_idx < 0 ? _ws.f_i[_t.tail[b_idx]] : _ws.f_e[a_idx];
+        float w_max = wmax[b_idx];
+        float w_min = wmin[b_idx];
+        float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
+        if (p_a[b_idx] == 0)
+            loaded.push_back(b_idx);
+        p_a[b_idx] += f_a / f * p;
+    }
+    _ws.po_edges.swap(loaded);
+    _ws.po_from.clear();
+}
+
+void hyperpath_search(const Topology &_t, const HyperpathWeights &_w,
+                      int _o_idx, int _d_idx, HyperpathWorkspace &_ws,
+                      const HyperpathPruning* _prune) {
+    _ws.recover();
+    _ws.stats.searches++;
+    if (_t.turn_cnt > 0) {
+        timed_search(_ws, [&] { turn_backward_pass(_t, _w, _o_idx, _d_idx, _ws); });
+        timed(_ws.stats.sort_ns, [&] { loading_order(_t, _w, _ws); });
+        timed(_ws.stats.load_ns, [&] {
+            seed(_o_idx, 1.0, _ws);
+            turn_forward_pass(_t, _w, _ws);
+        });
+        return;
+    }
+    timed_search(_ws, [&] {
+        if (_prune)
+            pruned_backward_pass(_t, _w, *_prune, _o_idx, _d_idx, _ws);
+        else
+            backward_pass(_t, _w, _o_idx, _d_idx, _ws);
+    });
+    timed(_ws.stats.sort_ns, [&] { loading_order(_t, _w, _ws); });
+    timed(_ws.stats.load_ns, [&] {
+        seed(_o_idx, 1.0, _ws);
+        forward_pass(_t, _w, _ws.f_i.data(), _ws.po_edges, _ws);
+    });
+}
+
+// W_i from the running sums of its attractive edges, all of which are in
+static inline float gev_cost(const HyperpathWorkspace &_ws, float _theta, int _i_idx, int _d_idx) {
+    if (_i_idx == _d_idx)
+        return 0.0;
+    return _ws.m_i[_i_idx] - log(_ws.s_i[_i_idx] / _ws.f_i[_i_idx]) / _theta;
+}
+
+void hyperpath_gev(const Topology &_t, const HyperpathWeights &_w, float _theta,
+                   int _o_idx, int _d_idx, HyperpathWorkspace &_ws) {
+    const float* wmin = _w.wmin;
+    const float* wmax = _w.wmax;
+    _ws.recover();
+    if (_ws.m_i.size() != size_t(_t.n)) {
+        _ws.m_i.assign(_t.n, numeric_limits<float>::infinity());
+        _ws.s_i.assign(_t.n, 0.0);
+    }
+    _ws.stats.searches++;
+    timed_search(_ws, [&] { backward_pass(_t, _w, _o_idx, _d_idx, _ws); });
+
+    // the W sums belong to the backward pass; the reversed loading order has
+    // the edges out of a vertex before those into it; the sums are shifted by
+    // their least term so that exp doesn't underflow
+    timed(_ws.stats.sort_ns, [&] { loading_order(_t, _w, _ws); });
+    int64_t start = now_ns();
+    float* m_i = _ws.m_i.data();
+    float* s_i = _ws.s_i.data();
+    for (auto it = _ws.po_edges.rbegin(); it != _ws.po_edges.rend(); ++it) {
+        int a_idx = *it;
+        int i_idx = _t.tail[a_idx];
+        float f_a = wmax[a_idx] == wmin[a_idx] ? LARGENUMBER : 1.0 / (wmax[a_idx] - wmin[a_idx]);
+        float x = 0.5 * (wmin[a_idx] + wmax[a_idx]) + gev_cost(_ws, _theta, _t.head[a_idx], _d_idx);
+        if (x < m_i[i_idx]) {
+            s_i[i_idx] = s_i[i_idx] * exp(-_theta * (m_i[i_idx] - x)) + f_a;
+            m_i[i_idx] = x;
+        } else {
+            s_i[i_idx] += f_a * exp(-_theta * (x - m_i[i_idx]));
+        }
+    }
+    _ws.stats.search_ns += now_ns() - start;
+
+    start = now_ns();
+    seed(_o_idx, 1.0, _ws);
+    float* p_i = _ws.p_i.data();
+    float* p_a = _ws.p_a.data();
+    for (const auto &a_idx : _ws.po_edges) {
+        int i_idx = _t.tail[a_idx];
+        int j_idx = _t.head[a_idx];
+        if (p_i[i_idx] == 0)
+            continue;
+        float f_a = wmax[a_idx] == wmin[a_idx] ? LARGENUMBER : 1.0 / (wmax[a_idx] - wmin[a_idx]);
+        float x = 0.5 * (wmin[a_idx] + wmax[a_idx]) + gev_cost(_ws, _theta, j_idx, _d_idx);
+        float P_a = f_a / _ws.f_i[i_idx] * exp(-_theta * (x - gev_cost(_ws, _theta, i_idx, _d_idx)));
+        p_a[a_idx] = P_a * p_i[i_idx];
+        _ws.touched_edges.push_back(a_idx);
+        _ws.touched_vertices.push_back(j_idx);
+        p_i[j_idx] += p_a[a_idx];
+    }
+    if (_ws.f_i[_o_idx] > 0)
+        _ws.u_i[_o_idx] = gev_cost(_ws, _theta, _o_idx, _d_idx);
+    _ws.stats.load_ns += now_ns() - start;
+}
+
+void hyperpath_tree(const Topology &_t, const HyperpathWeights &_w,
+                    int _d_idx, HyperpathWorkspace &_ws, HyperpathTree &_tree) {
+    HyperpathWeights w = _w;
+    w.h = nullptr;
+    _ws.recover();
+    _ws.stats.searches++;
+    timed_search(_ws, [&] { backward_pass(_t, w, -1, _d_idx, _ws); });
+    timed(_ws.stats.sort_ns, [&] { loading_order(_t, w, _ws); });
+    _tree.d_idx = _d_idx;
+    _tree.u_i = _ws.u_i;
+    _tree.f_i = _ws.f_i;
+    _tree.po_edges = _ws.po_edges;
+    _ws.recover();
+}
+
+// The attractive edges of a vertex are the prefix, by u_i[j] + wmin, of its
+// out-edges whose key doesn't exceed the final u_i. A changed edge thus
+// matters to the tree only when it is attractive or its new key gets down to
+// u_i of its tail. A vertex labelled below the smallest old or new key T of
+// such edges depends only on edges keyed below T, so it keeps its label and
+// attractive edges; the pass resumes from these with the in-edges of the kept
+// vertices back on the heap and the edges between kept vertices closed.
+bool hyperpath_repair(const Topology &_t, const HyperpathWeights &_w,
+                      const vector<int> &_edges, const vector<float> &_old_wmin,
+                      const HyperpathTree &_tree, HyperpathWorkspace &_ws,
+                      HyperpathTree &_repaired) {
+    const float* u = _tree.u_i.data();
+    const float inf = numeric_limits<float>::infinity();
+    vector<char> attractive(_edges.size(), false);
+    for (const auto &a_idx : _tree.po_edges) {
+        for (size_t k = 0; k < _edges.size(); ++k) {
+            if (_edges[k] == a_idx)
+                attractive[k] = true;
+        }
+    }
+
+    float T = inf;
+    for (size_t k = 0; k < _edges.size(); ++k) {
+        int a_idx = _edges[k];
+        float u_j = u[_t.head[a_idx]];
+        if (u_j == inf)
+            continue;
+        if (attractive[k] || u_j + _w.wmin[a_idx] <= u[_t.tail[a_idx]])
+            T = min(T, u_j + min(_old_wmin[k], _w.wmin[a_idx]));
+    }
+    if (T == inf)
+        return false;
+    if (u[_tree.d_idx] >= T) {
+        hyperpath_tree(_t, _w, _tree.d_idx, _ws, _repaired);
+        return true;
+    }
+
+    HyperpathWeights w = _w;
+    w.h = nullptr;
+    _ws.recover();
+    vector<int> kept;
+    for (int v = 0; v < _t.n; ++v) {
+        if (u[v] < T) {
+            _ws.u_i[v] = u[v];
+            _ws.f_i[v] = _tree.f_i[v];
+            _ws.touched_vertices.push_back(v);
+            kept.push_back(v);
+        }
+    }
+    // po_edges of the tree are in reversed settle order
+    for (auto it = _tree.po_edges.rbegin(); it != _tree.po_edges.rend(); ++it) {
+        if (u[_t.tail[*it]] < T)
+            _ws.po_edges.push_back(*it);
+    }
+    for (const auto &j_idx : kept) {
+        for (int k = _t.in_offset[j_idx]; k < _t.in_offset[j_idx + 1]; ++k) {
+            int a_idx = _t.in_edge[k];
+            _ws.u_a[a_idx] = u[j_idx] + w.wmin[a_idx];
+            _ws.touched_edges.push_back(a_idx);
+            if (u[_t.tail[a_idx]] < T) {
+                _ws.close[a_idx] = true; // settled with the kept labels
+            } else {
+                _ws.heap.insert(a_idx, _ws.u_a[a_idx]);
+                _ws.open[a_idx] = true;
+            }
+        }
+    }
+    _ws.stats.searches++;
+    timed_search(_ws, [&] { settle(_t, w, -1, _ws); });
+    timed(_ws.stats.sort_ns, [&] { loading_order(_t, w, _ws); });
+    _repaired.d_idx = _tree.d_idx;
+    _repaired.u_i = _ws.u_i;
+    _repaired.f_i = _ws.f_i;
+    _repaired.po_edges = _ws.po_edges;
+    _ws.recover();
+    return true;
+}
+
+void hyperpath_load(const Topology &_t, const HyperpathWeights &_w,
+                    const HyperpathTree &_tree, int _o_idx, HyperpathWorkspace &_ws) {
+    _ws.recover();
+    _ws.stats.searches++;
+    timed(_ws.stats.load_ns, [&] {
+        seed(_o_idx, 1.0, _ws);
+        forward_pass(_t, _w, _tree.f_i.data(), _tree.po_edges, _ws);
+    });
+}
+
+void hyperpath_demand(const Topology &_t, const HyperpathWeights &_w, int _d_idx,
+                      const int* _o_idx, const float* _volume, size_t _k,
+                      HyperpathWorkspace &_ws) {
+    HyperpathWeights w = _w;
+    w.h = nullptr;
+    _ws.recover();
+    _ws.stats.searches++;
+    if (_t.turn_cnt > 0) {
+        timed_search(_ws, [&] { turn_backward_pass(_t, w, -1, _d_idx, _ws); });
+        timed(_ws.stats.sort_ns, [&] { loading_order(_t, w, _ws); });
+        timed(_ws.stats.load_ns, [&] {
+            for (size_t i = 0; i < _k; ++i)
+                seed(_o_idx[i], _volume[i], _ws);
+            turn_forward_pass(_t, w, _ws);
+        });
+        return;
+    }
+    timed_search(_ws, [&] { backward_pass(_t, w, -1, _d_idx, _ws); });
+    timed(_ws.stats.sort_ns, [&] { loading_order(_t, w, _ws); });
+    timed(_ws.stats.load_ns, [&] {
+        for (size_t i = 0; i < _k; ++i)
+            seed(_o_idx[i], _volume[i], _ws);
+        forward_pass(_t, w, _ws.f_i.data(), _ws.po_edges, _ws);
+    });
+}
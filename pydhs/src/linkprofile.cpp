@@ -0,0 +1,152 @@
+//
+//  linkprofile.cpp
+//  MyGraph
+//
+
+#include "linkprofile.h"
+#include "csvload.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sys/stat.h>
+
+namespace {
+
+const char MAGIC[8] = {'P', 'Y', 'D', 'H', 'S', 'P', 'F', '1'};
+
+struct Header {
+    char magic[8];
+    uint64_t m;
+    uint64_t bins;
+    float t0;
+    float bin_width;
+    uint64_t ids; // hash of the edge ids in idx order
+    uint64_t source_size;
+    int64_t source_mtime; // ns
+};
+
+// FNV-1a of the edge ids, each with its terminating 0, so the cache is
+// only used for a graph with the same edges at the same idx
+uint64_t hash_edge_ids(const Graph &_g) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < _g.get_edge_number(); ++i) {
+        const string id = _g.get_eid(int(i));
+        for (size_t j = 0; j <= id.size(); ++j) {
+            h ^= (unsigned char)id.c_str()[j];
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+// size and modification time of _path, false when it doesn't exist
+bool stamp(const string &_path, uint64_t &_size, int64_t &_mtime) {
+    struct stat st;
+    if (stat(_path.c_str(), &st) != 0)
+        return false;
+    _size = st.st_size;
+    _mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+}
+
+LinkProfile::LinkProfile(int _m, int _bins, float _t0, float _bin_width)
+    : m(_m), bins(_bins), t0(_t0), bin_width(_bin_width), values(size_t(_m) * _bins, 0.0f) {
+}
+
+void LinkProfile::save(const Graph &_g, const string &_source, const string &_cache) const {
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.m = m;
+    h.bins = bins;
+    h.t0 = t0;
+    h.bin_width = bin_width;
+    h.ids = hash_edge_ids(_g);
+    stamp(_source, h.source_size, h.source_mtime);
+    const string tmp = _cache + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        throw "ERROR: can't write " + tmp;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+        && fwrite(values.data(), sizeof(float), values.size(), f) == values.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), _cache.c_str()) != 0) {
+        remove(tmp.c_str());
+        throw "ERROR: can't write " + _cache;
+    }
+}
+
+LinkProfile* LinkProfile::load_cache(const Graph &_g, const string &_source,
+                                     const string &_cache) {
+    FILE* f = fopen(_cache.c_str(), "rb");
+    if (!f)
+        return nullptr;
+    unique_ptr<FILE, int (*)(FILE*)> file(f, fclose);
+    Header h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0
+        || h.m != _g.get_edge_number() || h.bins == 0 || h.ids != hash_edge_ids(_g))
+        return nullptr;
+    uint64_t size;
+    int64_t mtime;
+    if (stamp(_source, size, mtime) && (size != h.source_size || mtime != h.source_mtime))
+        return nullptr;
+    unique_ptr<LinkProfile> p(new LinkProfile(int(h.m), int(h.bins), h.t0, h.bin_width));
+    if (fread(p->values.data(), sizeof(float), p->values.size(), f) != p->values.size())
+        return nullptr;
+    return p.release();
+}
+
+LinkProfile* load_link_profile(const Graph &_g, const string &_path, const string &_cache,
+                               const float* _fill, char _delimiter, int _threads) {
+    if (!_cache.empty()) {
+        LinkProfile* p = LinkProfile::load_cache(_g, _path, _cache);
+        if (p)
+            return p;
+    }
+    vector<string> header;
+    vector<string> keys;
+    vector<float> values;
+    load_csv_table(_path, _delimiter, _threads, header, keys, values);
+    const int bins = int(header.size());
+    if (bins == 0)
+        throw "ERROR: no bin times in the header of " + _path;
+    vector<float> times(bins);
+    for (int k = 0; k < bins; ++k) {
+        char* end = nullptr;
+        times[k] = strtof(header[k].c_str(), &end);
+        if (header[k].empty() || *end != '\0')
+            throw "ERROR: bad bin time " + header[k] + " in " + _path;
+    }
+    const float width = bins > 1 ? times[1] - times[0] : 1.0f;
+    for (int k = 1; k < bins; ++k) {
+        if (!(width > 0) || fabs(times[k] - times[0] - k * width) > 1e-3f * width)
+            throw "ERROR: bin times of " + _path + " aren't equally spaced";
+    }
+
+    const int m = int(_g.get_edge_number());
+    unique_ptr<LinkProfile> p(new LinkProfile(m, bins, times[0], width));
+    vector<char> seen(m, 0);
+    for (size_t r = 0; r < keys.size(); ++r) {
+        int idx = _g.find_eidx(keys[r]);
+        if (idx < 0)
+            continue;
+        seen[idx] = 1;
+        for (int k = 0; k < bins; ++k)
+            p->column(k)[idx] = values[r * bins + k];
+    }
+    for (int i = 0; i < m; ++i) {
+        if (seen[i])
+            continue;
+        if (!_fill)
+            throw "ERROR: edge " + _g.get_eid(i) + " has no row in " + _path;
+        for (int k = 0; k < bins; ++k)
+            p->column(k)[i] = _fill[i];
+    }
+    if (!_cache.empty())
+        p->save(_g, _path, _cache);
+    return p.release();
+}
@@ -0,0 +1,259 @@
+//
+//  matsim.cpp
+//  MyGraph
+//
+
+#include "matsim.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// the tags of an XML file, one at a time, from a block buffer. Only what
+// network.xml uses is understood: elements with attributes, comments,
+// processing instructions, DOCTYPE, and the predefined and numeric entities.
+class TagReader {
+public:
+    TagReader(const string &_path) : path(_path), file(fopen(_path.c_str(), "rb")),
+                                     buffer(1 << 20), begin(0), end(0) {
+        if (!file)
+            throw "ERROR: can't read " + _path;
+    }
+
+    ~TagReader() {
+        fclose(file);
+    }
+
+    // the next start tag with its attributes; end tags, comments and the
+    // like are skipped. False at the end of the file.
+    bool next(string &_name, vector<pair<string, string> > &_attrs) {
+        int c;
+        while (true) {
+            while ((c = get()) != '<') {
+                if (c == EOF)
+                    return false;
+            }
+            c = get();
+            if (c == '!') {
+                if (get() == '-' && get() == '-')
+                    skip("-->");
+                else
+                    skip(">"); // DOCTYPE, brackets inside aren't used by MATSim
+            } else if (c == '?') {
+                skip("?>");
+            } else if (c == '/') {
+                skip(">");
+            } else {
+                break;
+            }
+        }
+        _name.clear();
+        _attrs.clear();
+        while (c != EOF && !isspace(c) && c != '/' && c != '>') {
+            _name += char(c);
+            c = get();
+        }
+        while (true) {
+            while (c != EOF && isspace(c))
+                c = get();
+            if (c == '>')
+                return true;
+            if (c == '/') {
+                c = get();
+                continue;
+            }
+            if (c == EOF)
+                throw "ERROR: unexpected end of " + path;
+            string key;
+            while (c != EOF && c != '=' && !isspace(c) && c != '>') {
+                key += char(c);
+                c = get();
+            }
+            while (c != EOF && isspace(c))
+                c = get();
+            if (c == EOF)
+                throw "ERROR: unexpected end of " + path;
+            if (c != '=')
+                throw "ERROR: attribute without value in " + path;
+            c = get();
+            while (c != EOF && isspace(c))
+                c = get();
+            if (c != '"' && c != '\'')
+                throw "ERROR: unquoted attribute in " + path;
+            const int quote = c;
+            string value;
+            while ((c = get()) != quote) {
+                if (c == EOF)
+                    throw "ERROR: unexpected end of " + path;
+                if (c == '&')
+                    entity(value);
+                else
+                    value += char(c);
+            }
+            _attrs.push_back(make_pair(key, value));
+            c = get();
+        }
+    }
+
+private:
+    int get() {
+        if (begin == end) {
+            end = fread(buffer.data(), 1, buffer.size(), file);
+            begin = 0;
+            if (end == 0)
+                return EOF;
+        }
+        return (unsigned char)buffer[begin++];
+    }
+
+    // reads up to and including _until
+    void skip(const char* _until) {
+        const size_t k = strlen(_until);
+        string last;
+        while (last.size() < k || last.compare(last.size() - k, k, _until) != 0) {
+            int c = get();
+            if (c == EOF)
+                throw "ERROR: unexpected end of " + path;
+            last += char(c);
+            if (last.size() > 2 * k)
+                last.erase(0, last.size() - k);
+        }
+    }
+
+    // appends the character of an entity whose '&' has been read, UTF-8
+    // encoded
+    void entity(string &_value) {
+        string name;
+        int c;
+        while ((c = get()) != ';') {
+            if (c == EOF || name.size() > 8)
+                throw "ERROR: bad entity in " + path;
+            name += char(c);
+        }
+        long code;
+        if (name == "amp")
+            code = '&';
+        else if (name == "lt")
+            code = '<';
+        else if (name == "gt")
+            code = '>';
+        else if (name == "quot")
+            code = '"';
+        else if (name == "apos")
+            code = '\'';
+        else if (name.size() > 1 && name[0] == '#')
+            code = name[1] == 'x' ? strtol(name.c_str() + 2, nullptr, 16) : atol(name.c_str() + 1);
+        else
+            throw "ERROR: bad entity &" + name + "; in " + path;
+        if (code < 0x80) {
+            _value += char(code);
+        } else if (code < 0x800) {
+            _value += char(0xc0 | (code >> 6));
+            _value += char(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            _value += char(0xe0 | (code >> 12));
+            _value += char(0x80 | ((code >> 6) & 0x3f));
+            _value += char(0x80 | (code & 0x3f));
+        } else {
+            _value += char(0xf0 | (code >> 18));
+            _value += char(0x80 | ((code >> 12) & 0x3f));
+            _value += char(0x80 | ((code >> 6) & 0x3f));
+            _value += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    string path;
+    FILE* file;
+    vector<char> buffer;
+    size_t begin;
+    size_t end;
+};
+
+float to_float(const string &_value, const MatsimLink &_link, const char* _attr) {
+    char* end = nullptr;
+    float x = strtof(_value.c_str(), &end);
+    if (end == _value.c_str())
+        throw "ERROR: link " + _link.id + " has a bad " + _attr + ": " + _value;
+    return x;
+}
+
+}
+
+void read_matsim_links(const string &_path, const function<void(const MatsimLink &)> &_link) {
+    TagReader reader(_path);
+    string name;
+    vector<pair<string, string> > attrs;
+    MatsimLink link;
+    while (reader.next(name, attrs)) {
+        if (name != "link")
+            continue;
+        link.id.clear();
+        link.from.clear();
+        link.to.clear();
+        link.capacity = 0;
+        link.permlanes = 1;
+        // the id first, for the messages
+        for (const auto &a : attrs) {
+            if (a.first == "id")
+                link.id = a.second;
+        }
+        bool length = false;
+        bool freespeed = false;
+        for (const auto &a : attrs) {
+            if (a.first == "from") {
+                link.from = a.second;
+            } else if (a.first == "to") {
+                link.to = a.second;
+            } else if (a.first == "length") {
+                link.length = to_float(a.second, link, "length");
+                length = true;
+            } else if (a.first == "freespeed") {
+                link.freespeed = to_float(a.second, link, "freespeed");
+                freespeed = true;
+            } else if (a.first == "capacity") {
+                link.capacity = to_float(a.second, link, "capacity");
+            } else if (a.first == "permlanes") {
+                link.permlanes = to_float(a.second, link, "permlanes");
+            }
+        }
+        if (link.id.empty() || link.from.empty() || link.to.empty() || !length || !freespeed)
+            throw "ERROR: link " + link.id + " lacks id, from, to, length or freespeed in " + _path;
+        _link(link);
+    }
+}
+
+Graph* load_matsim_graph(const string &_path, vector<float> &_length, vector<float> &_freespeed) {
+    // the edge count is only known at the end and sizes the Graph, so the
+    // links are kept until then, without anything else of the file
+    vector<string> ids;
+    vector<float> length;
+    vector<float> freespeed;
+    read_matsim_links(_path, [&](const MatsimLink &_link) {
+        ids.push_back(_link.id);
+        ids.push_back(_link.from);
+        ids.push_back(_link.to);
+        length.push_back(_link.length);
+        freespeed.push_back(_link.freespeed);
+    });
+    const size_t m = length.size();
+    // at most two new vertices per edge, the Graph only reserves pointers
+    unique_ptr<Graph> g(new Graph(int(2 * m), int(m)));
+    _length.clear();
+    _freespeed.clear();
+    for (size_t i = 0; i < m; ++i) {
+        size_t before = g->get_edge_number();
+        g->add_edge(ids[3 * i], ids[3 * i + 1], ids[3 * i + 2]);
+        if (g->get_edge_number() > before) {
+            _length.push_back(length[i]);
+            _freespeed.push_back(freespeed[i]);
+        }
+        // the ids are in the graph now
+        string().swap(ids[3 * i]);
+        string().swap(ids[3 * i + 1]);
+        string().swap(ids[3 * i + 2]);
+    }
+    return g.release();
+}
@@ -0,0 +1,244 @@
+//
+//  network.cpp
+//  MyGraph
+//
+
+#include "network.h"
+#include "pyhelper.h"
+#include <atomic>
+
+WorkspacePool::WorkspacePool(const Topology &_t) {
+    n = _t.n;
+    m = _t.m;
+    turn_cnt = _t.turn_cnt;
+    created = 0;
+}
+
+WorkspacePool::Lease::Lease(WorkspacePool &_pool) : pool(_pool) {
+    {
+        lock_guard<mutex> guard(pool.lock);
+        if (!pool.idle.empty()) {
+            ws = move(pool.idle.back());
+            pool.idle.pop_back();
+            return;
+        }
+        pool.created++;
+    }
+    // allocated outside the lock, other queries go on meanwhile
+    ws.reset(new HyperpathWorkspace(pool.n, pool.m, pool.turn_cnt));
+}
+
+WorkspacePool::Lease::~Lease() {
+    lock_guard<mutex> guard(pool.lock);
+    pool.idle.push_back(move(ws));
+}
+
+size_t WorkspacePool::size() const {
+    lock_guard<mutex> guard(lock);
+    return created;
+}
+
+// wmax None for deterministic weights
+Network::Network(Graph* const _g, const bp::object &_wmin, const bp::object &_wmax, int _cache,
+                 int _threads)
+    : g(_g), t(_g->get_topology()), pool(t), threads(_threads) {
+    shared_ptr<WeightSnapshot> w = make_shared<WeightSnapshot>();
+    w->wmin = to_floats(_wmin, t.m);
+    w->wmax = _wmax.is_none() ? w->wmin : to_floats(_wmax, t.m);
+    w->version = 0;
+    atomic_store(&weights, shared_ptr<const WeightSnapshot>(w));
+    if (_cache > 0)
+        potentials.reset(new PotentialCache(_cache));
+    future_type = bp::import("concurrent.futures").attr("Future");
+}
+
+Network::~Network() {
+    if (tasks) {
+        // the workers need the GIL to set the last futures
+        ScopedGILRelease nogil;
+        tasks.reset();
+    }
+}
+
+void Network::search(int _o_idx, int _d_idx, vector<int> &_edges, vector<float> &_probs,
+                     float &_cost) {
+    shared_ptr<const WeightSnapshot> snapshot = atomic_load(&weights);
+    WorkspacePool::Lease ws(pool);
+    HyperpathWeights w;
+    w.wmin = snapshot->wmin.data();
+    w.wmax = snapshot->wmax.data();
+    w.h = nullptr;
+    PotentialCache::Potentials cached;
+    if (potentials) {
+        cached = potentials->get(t, w.wmin, snapshot->version, _o_idx);
+        w.h = cached->data();
+    }
+    hyperpath_search(t, w, _o_idx, _d_idx, *ws);
+    int64_t start = now_ns();
+    for (const auto &a_idx : (*ws).po_edges) {
+        if ((*ws).p_a[a_idx] != 0) {
+            _edges.push_back(a_idx);
+            _probs.push_back((*ws).p_a[a_idx]);
+        }
+    }
+    _cost = (*ws).u_i[_o_idx];
+    (*ws).stats.output_ns += now_ns() - start;
+    // the workspace goes back to the pool without its stats
+    lock_guard<mutex> guard(stats_lock);
+    total.add((*ws).stats);
+    (*ws).stats.clear();
+}
+
+SearchStats Network::get_total_stats() const {
+    lock_guard<mutex> guard(stats_lock);
+    return total;
+}
+
+void Network::reset_stats() {
+    lock_guard<mutex> guard(stats_lock);
+    total.clear();
+}
+
+bp::tuple Network::hyperpath(const string &_oid, const string &_did) {
+    auto o_idx = g->get_vidx(_oid);
+    auto d_idx = g->get_vidx(_did);
+    vector<int> edges;
+    vector<float> probs;
+    float cost;
+    {
+        ScopedGILRelease nogil;
+        search(o_idx, d_idx, edges, probs, cost);
+    }
+    return bp::make_tuple(to_ndarray(edges), to_ndarray(probs), cost);
+}
+
+void Network::check_no_turns() const {
+    if (t.turn_cnt > 0) {
+        PyErr_SetString(PyExc_ValueError, "shortest doesn't support turn tables");
+        bp::throw_error_already_set();
+    }
+}
+
+np::ndarray Network::shortest(const string &_oid) {
+    auto o_idx = g->get_vidx(_oid);
+    check_no_turns();
+    vector<float> u(t.n);
+    {
+        ScopedGILRelease nogil;
+        shared_ptr<const WeightSnapshot> snapshot = atomic_load(&weights);
+        lower_bounds(t, snapshot->wmin.data(), o_idx, u.data());
+    }
+    return to_ndarray(u);
+}
+
+bp::object Network::submit_run(const string &_oid, const string &_did) {
+    return submit(g->get_vidx(_oid), g->get_vidx(_did), false);
+}
+
+bp::object Network::submit_shortest(const string &_oid) {
+    auto o_idx = g->get_vidx(_oid);
+    check_no_turns();
+    return submit(o_idx, -1, true);
+}
+
+bp::object Network::submit(int _o_idx, int _d_idx, bool _shortest) {
+    if (!tasks) {
+        // sized first, a worker may flush as soon as it starts
+        outbox.resize(worker_count(threads, size_t(-1)));
+        tasks.reset(new TaskPool(outbox.size(), [this](int w) { deliver(w); }));
+    }
+    bp::object future = future_type();
+    PyObject* f = future.ptr();
+    Py_INCREF(f);
+    tasks->submit([this, f, _o_idx, _d_idx, _shortest](int w) {
+        Answer a;
+        a.future = f;
+        a.shortest = _shortest;
+        if (_shortest) {
+            a.u.resize(t.n);
+            shared_ptr<const WeightSnapshot> snapshot = atomic_load(&weights);
+            lower_bounds(t, snapshot->wmin.data(), _o_idx, a.u.data());
+        } else {
+            search(_o_idx, _d_idx, a.edges, a.probs, a.cost);
+        }
+        outbox[w].push_back(move(a));
+        if (outbox[w].size() >= 64)
+            deliver(w);
+    });
+    return future;
+}
+
+void Network::deliver(int _worker) {
+    vector<Answer> &answers = outbox[_worker];
+    if (answers.empty())
+        return;
+    PyGILState_STATE gil = PyGILState_Ensure();
+    for (auto &a : answers) {
+        try {
+            bp::object future(bp::handle<>(a.future)); // takes over the reference
+            // false when cancelled; otherwise the future is running and can't
+            // be cancelled any more before its result is set
+            if (bp::extract<bool>(future.attr("set_running_or_notify_cancel")())) {
+                if (a.shortest)
+                    future.attr("set_result")(to_ndarray(a.u));
+                else
+                    future.attr("set_result")(bp::make_tuple(to_ndarray(a.edges),
+                                                             to_ndarray(a.probs), a.cost));
+            }
+        } catch (const bp::error_already_set &) {
+            PyErr_Print();
+        }
+    }
+    answers.clear();
+    PyGILState_Release(gil);
+}
+
+unsigned long Network::update(const bp::object &_wmin, const bp::object &_wmax,
+                              const bp::object &_edges) {
+    vector<int> edges;
+    vector<float> wmin;
+    vector<float> wmax;
+    const bool all = _edges.is_none();
+    if (all) {
+        wmin = to_floats(_wmin, t.m);
+        wmax = _wmax.is_none() ? wmin : to_floats(_wmax, t.m);
+    } else {
+        size_t k = bp::len(_edges);
+        for (size_t i = 0; i < k; ++i) {
+            edges.push_back(bp::extract<int>(_edges[i]));
+            if (edges.back() < 0 || edges.back() >= t.m) {
+                PyErr_SetString(PyExc_IndexError, "edge index out of range");
+                bp::throw_error_already_set();
+            }
+        }
+        wmin = to_floats(_wmin, k);
+        wmax = _wmax.is_none() ? wmin : to_floats(_wmax, k);
+    }
+
+    ScopedGILRelease nogil;
+    lock_guard<mutex> guard(update_lock);
+    shared_ptr<const WeightSnapshot> old = atomic_load(&weights);
+    shared_ptr<WeightSnapshot> w = make_shared<WeightSnapshot>();
+    if (all) {
+        w->wmin.swap(wmin);
+        w->wmax.swap(wmax);
+    } else {
+        w->wmin = old->wmin;
+        w->wmax = old->wmax;
+        for (size_t i = 0; i < edges.size(); ++i) {
+            w->wmin[edges[i]] = wmin[i];
+            w->wmax[edges[i]] = wmax[i];
+        }
+    }
+    w->version = old->version + 1;
+    atomic_store(&weights, shared_ptr<const WeightSnapshot>(w));
+    return w->version;
+}
+
+unsigned long Network::get_version() const {
+    return atomic_load(&weights)->version;
+}
+
+size_t Network::get_workspaces() const {
+    return pool.size();
+}
@@ -0,0 +1,101 @@
+//
+//  potential.cpp
+//  MyGraph
+//
+
+#include "potential.h"
+#include "fibheap.h"
+#include <limits>
+
+void lower_bounds(const Topology &_t, const float *_weights, int _root_idx, float *_u) {
+    size_t n = _t.n;
+    vector<bool> close(n, false);
+    vector<bool> open(n, false);
+    for (unsigned int i = 0; i < n; ++i)
+        _u[i] = numeric_limits<float>::infinity();
+
+    FHeap heap(n);
+    _u[_root_idx] = 0.0;
+    heap.insert(_root_idx, 0.0);
+    open[_root_idx] = true;
+
+    while (heap.nItems() > 0) {
+        int i_idx = heap.deleteMin();
+        open[i_idx] = false;
+        close[i_idx] = true;
+        for (int k = _t.out_offset[i_idx]; k < _t.out_offset[i_idx + 1]; ++k) {
+            int a_idx = _t.out_edge[k];
+            int j_idx = _t.head[a_idx];
+            if (close[j_idx])
+                continue;
+            float dist = _u[i_idx] + _weights[a_idx];
+            if (dist < _u[j_idx]) {
+                _u[j_idx] = dist;
+                if (open[j_idx]) {
+                    heap.decreaseKey(j_idx, dist);
+                } else {
+                    heap.insert(j_idx, dist);
+                    open[j_idx] = true;
+                }
+            }
+        }
+    }
+}
+
+PotentialCache::PotentialCache(size_t _capacity) {
+    capacity = _capacity;
+    hits = 0;
+    misses = 0;
+}
+
+PotentialCache::Potentials PotentialCache::get(const Topology &_t, const float *_weights,
+                                               unsigned long _version, int _root_idx) {
+    Key key(_version, _root_idx);
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            hits++;
+            return it->second->second;
+        }
+        misses++;
+    }
+
+    // computed outside the lock so that concurrent misses don't serialize
+    shared_ptr<vector<float> > u = make_shared<vector<float> >(_t.n);
+    lower_bounds(_t, _weights, _root_idx, u->data());
+
+    lock_guard<mutex> guard(lock);
+    auto it = index.find(key);
+    if (it != index.end())
+        return it->second->second;
+    entries.push_front(make_pair(key, Potentials(u)));
+    index[key] = entries.begin();
+    while (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    return u;
+}
+
+void PotentialCache::clear() {
+    lock_guard<mutex> guard(lock);
+    entries.clear();
+    index.clear();
+}
+
+size_t PotentialCache::size() const {
+    lock_guard<mutex> guard(lock);
+    return entries.size();
+}
+
+size_t PotentialCache::get_hits() const {
+    lock_guard<mutex> guard(lock);
+    return hits;
+}
+
+size_t PotentialCache::get_misses() const {
+    lock_guard<mutex> guard(lock);
+    return misses;
+}
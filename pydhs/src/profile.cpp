@@ -0,0 +1,65 @@
+//
+//  profile.cpp
+//  MyGraph
+//
+
+#include "profile.h"
+#include "fibheap.h"
+#include <limits>
+
+TimeProfile::TimeProfile(int _m, int _bins, float _t0, float _bin_width, bool _linear,
+                         const vector<float> &_values)
+    : m(_m), bins(_bins), t0(_t0), bin_width(_bin_width), linear(_linear),
+      values(_values), reach(_values.size()) {
+    // both kinds of profile are linear or constant between samples, so the
+    // least weight from a sample on is found at one of the later samples
+    for (int a = 0; a < m; ++a) {
+        float* r = &reach[size_t(a) * bins];
+        const float* w = &values[size_t(a) * bins];
+        r[bins - 1] = w[bins - 1];
+        for (int k = bins - 2; k >= 0; --k)
+            r[k] = min(w[k], bin_width + r[k + 1]);
+    }
+}
+
+// label setting is exact for FIFO weights: entering an edge later never
+// leaves it earlier
+void td_arrivals(const Topology &_t, const TimeProfile &_w, int _root_idx, float _time,
+                 float *_u, int *_pre) {
+    vector<char> close(_t.n, false);
+    vector<char> open(_t.n, false);
+    for (int i = 0; i < _t.n; ++i) {
+        _u[i] = numeric_limits<float>::infinity();
+        if (_pre)
+            _pre[i] = -1;
+    }
+
+    FHeap heap(_t.n);
+    _u[_root_idx] = 0.0;
+    heap.insert(_root_idx, 0.0);
+    open[_root_idx] = true;
+
+    while (heap.nItems() > 0) {
+        int i_idx = heap.deleteMin();
+        open[i_idx] = false;
+        close[i_idx] = true;
+        for (int k = _t.out_offset[i_idx]; k < _t.out_offset[i_idx + 1]; ++k) {
+            int a_idx = _t.out_edge[k];
+            int j_idx = _t.head[a_idx];
+            if (close[j_idx])
+                continue;
+            float dist = _u[i_idx] + _w.at(a_idx, _time + _u[i_idx]);
+            if (dist < _u[j_idx]) {
+                _u[j_idx] = dist;
+                if (_pre)
+                    _pre[j_idx] = a_idx;
+                if (open[j_idx]) {
+                    heap.decreaseKey(j_idx, dist);
+                } else {
+                    heap.insert(j_idx, dist);
+                    open[j_idx] = true;
+                }
+            }
+        }
+    }
+}
@@ -7,6 +7,7 @@ using namespace std;
 RadixHeap::RadixHeap(int n)
 {
     itemCount = 0;
+    compCount = 0;
     dMin = 0;
     nBuckets = static_cast<int>( ceil(log(MaxKey + 1.0)/log(2.0)) + 2.0 );
     
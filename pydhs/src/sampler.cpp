@@ -0,0 +1,87 @@
+//
+//  sampler.cpp
+//  MyGraph
+//
+
+#include "sampler.h"
+#include <algorithm>
+#include <numeric>
+
+// Vose's construction: slots below the mean are topped up by one slot above
+// it, which then continues with what is left of its own share
+RouteSampler::RouteSampler(const Topology &_t, const vector<int> &_edges,
+                           const vector<float> &_probs)
+    : t(_t), first(_t.n, -1), count(_t.n, 0) {
+    vector<size_t> order(_edges.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return _t.tail[_edges[a]] < _t.tail[_edges[b]];
+    });
+
+    choice.resize(_edges.size());
+    keep.resize(_edges.size());
+    alias.resize(_edges.size());
+    vector<double> share(_edges.size());
+    vector<int> small;
+    vector<int> large;
+    size_t begin = 0;
+    while (begin < order.size()) {
+        int i_idx = _t.tail[_edges[order[begin]]];
+        size_t end = begin;
+        double total = 0;
+        while (end < order.size() && _t.tail[_edges[order[end]]] == i_idx)
+            total += _probs[order[end++]];
+        int k = int(end - begin);
+        first[i_idx] = int(begin);
+        count[i_idx] = k;
+
+        small.clear();
+        large.clear();
+        for (int s = 0; s < k; ++s) {
+            choice[begin + s] = _edges[order[begin + s]];
+            share[begin + s] = _probs[order[begin + s]] * k / total;
+            alias[begin + s] = s;
+            (share[begin + s] < 1.0 ? small : large).push_back(s);
+        }
+        while (!small.empty() && !large.empty()) {
+            int l = small.back();
+            int g = large.back();
+            small.pop_back();
+            keep[begin + l] = share[begin + l];
+            alias[begin + l] = g;
+            share[begin + g] -= 1.0 - share[begin + l];
+            if (share[begin + g] < 1.0) {
+                large.pop_back();
+                small.push_back(g);
+            }
+        }
+        // rounding leaves the remaining slots at about 1
+        for (const auto &s : small)
+            keep[begin + s] = 1.0;
+        for (const auto &s : large)
+            keep[begin + s] = 1.0;
+        begin = end;
+    }
+}
+
+bool RouteSampler::sample(int _o_idx, int _d_idx, SplitMix64 &_rng, vector<int> &_route) const {
+    size_t start = _route.size();
+    int i_idx = _o_idx;
+    // a hyperpath has no cycles; the cap only guards against a broken input
+    size_t cap = choice.size();
+    while (i_idx != _d_idx) {
+        if (first[i_idx] < 0 || _route.size() - start > cap) {
+            _route.resize(start);
+            return false;
+        }
+        double x = _rng.uniform() * count[i_idx];
+        int s = min(int(x), count[i_idx] - 1);
+        int slot = first[i_idx] + s;
+        if (x - s >= keep[slot])
+            slot = first[i_idx] + alias[slot];
+        int a_idx = choice[slot];
+        _route.push_back(a_idx);
+        i_idx = t.head[a_idx];
+    }
+    return true;
+}
@@ -0,0 +1,179 @@
+//
+//  scenario.cpp
+//  MyGraph
+//
+
+#include "scenario.h"
+#include "pyhelper.h"
+#include <algorithm>
+#include <limits>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LANE_SIMD
+#include <immintrin.h>
+#endif
+
+static bool relax_plain(const float* _ui, const float* _wa, float* _uj,
+                        int _lanes, float &_best) {
+    bool improved = false;
+    for (int s = 0; s < _lanes; ++s) {
+        float c = _ui[s] + _wa[s];
+        if (c < _uj[s]) {
+            _uj[s] = c;
+            _best = min(_best, c);
+            improved = true;
+        }
+    }
+    return improved;
+}
+
+#ifdef LANE_SIMD
+__attribute__((target("avx2")))
+static bool relax_avx2(const float* _ui, const float* _wa, float* _uj,
+                       int _lanes, float &_best) {
+    const __m256 inf = _mm256_set1_ps(numeric_limits<float>::infinity());
+    __m256 best = inf;
+    int improved = 0;
+    for (int s = 0; s < _lanes; s += 8) {
+        __m256 c = _mm256_add_ps(_mm256_loadu_ps(_ui + s), _mm256_loadu_ps(_wa + s));
+        __m256 uj = _mm256_loadu_ps(_uj + s);
+        __m256 lt = _mm256_cmp_ps(c, uj, _CMP_LT_OQ);
+        improved |= _mm256_movemask_ps(lt);
+        _mm256_storeu_ps(_uj + s, _mm256_min_ps(c, uj));
+        best = _mm256_min_ps(best, _mm256_blendv_ps(inf, c, lt));
+    }
+    if (!improved)
+        return false;
+    float b[8];
+    _mm256_storeu_ps(b, best);
+    for (int k = 0; k < 8; ++k)
+        _best = min(_best, b[k]);
+    return true;
+}
+
+__attribute__((target("avx512f")))
+static bool relax_avx512(const float* _ui, const float* _wa, float* _uj,
+                         int _lanes, float &_best) {
+    const __m512 inf = _mm512_set1_ps(numeric_limits<float>::infinity());
+    __m512 best = inf;
+    int improved = 0;
+    for (int s = 0; s < _lanes; s += 16) {
+        // lanes come in multiples of 8, the last step may be half full
+        __mmask16 full = _lanes - s >= 16 ? 0xffff : 0x00ff;
+        __m512 c = _mm512_add_ps(_mm512_mask_loadu_ps(inf, full, _ui + s),
+                                 _mm512_mask_loadu_ps(inf, full, _wa + s));
+        __m512 uj = _mm512_mask_loadu_ps(inf, full, _uj + s);
+        __mmask16 lt = _mm512_mask_cmp_ps_mask(full, c, uj, _CMP_LT_OQ);
+        improved |= lt;
+        _mm512_mask_storeu_ps(_uj + s, lt, c);
+        best = _mm512_mask_min_ps(best, lt, best, c);
+    }
+    if (!improved)
+        return false;
+    float b[16];
+    _mm512_storeu_ps(b, best);
+    for (int k = 0; k < 16; ++k)
+        _best = min(_best, b[k]);
+    return true;
+}
+#endif
+
+LaneRelax lane_relax() {
+#ifdef LANE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return relax_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return relax_avx2;
+#endif
+    return relax_plain;
+}
+
+ScenarioDijkstra::ScenarioDijkstra(Graph* const _g) {
+    g = _g;
+    scenarios = 0;
+    lanes = 0;
+    relax = lane_relax();
+}
+
+void ScenarioDijkstra::set_weights(const bp::object &_weights) {
+    size_t m = g->get_edge_number();
+    int cols = 0;
+    vector<float> w = to_matrix(_weights, m, cols);
+    scenarios = cols;
+    lanes = (cols + 7) / 8 * 8;
+    // padding lanes weigh nothing but their labels stay infinite
+    weights.assign(m * lanes, 0.0);
+    for (size_t a = 0; a < m; ++a)
+        copy(&w[a * cols], &w[a * cols] + cols, &weights[a * lanes]);
+}
+
+void ScenarioDijkstra::run(const string &_oid) {
+    auto o_idx = g->get_vidx(_oid);
+    if (scenarios == 0) {
+        PyErr_SetString(PyExc_ValueError, "no weights set, call set_weights first");
+        bp::throw_error_already_set();
+    }
+    const Topology &t = g->get_topology();
+    if (t.turn_cnt > 0) {
+        PyErr_SetString(PyExc_ValueError, "ScenarioDijkstra doesn't support turn tables");
+        bp::throw_error_already_set();
+    }
+    const float inf = numeric_limits<float>::infinity();
+    u.assign(size_t(t.n) * lanes, inf);
+    pending.assign(t.n, inf);
+    open.assign(t.n, false);
+    fill(&u[size_t(o_idx) * lanes], &u[size_t(o_idx) * lanes] + scenarios, 0.0f);
+
+    FHeap heap(t.n);
+    SearchStats s;
+    int64_t start = now_ns();
+    heap.insert(o_idx, 0.0);
+    open[o_idx] = true;
+    pending[o_idx] = 0.0;
+    s.inserts++;
+
+    while (heap.nItems() > 0) {
+        int i_idx = heap.deleteMin();
+        s.delete_mins++;
+        open[i_idx] = false;
+        pending[i_idx] = inf;
+        s.vertices_scanned++;
+        s.edges_scanned += t.out_offset[i_idx + 1] - t.out_offset[i_idx];
+        const float* ui = &u[size_t(i_idx) * lanes];
+        for (int k = t.out_offset[i_idx]; k < t.out_offset[i_idx + 1]; ++k) {
+            int a_idx = t.out_edge[k];
+            int j_idx = t.head[a_idx];
+            float best = inf;
+            if (!relax(ui, &weights[size_t(a_idx) * lanes], &u[size_t(j_idx) * lanes], lanes, best))
+                continue;
+            if (!open[j_idx]) {
+                heap.insert(j_idx, best);
+                open[j_idx] = true;
+                pending[j_idx] = best;
+                s.inserts++;
+            } else if (best < pending[j_idx]) {
+                heap.decreaseKey(j_idx, best);
+                pending[j_idx] = best;
+                s.decrease_keys++;
+            }
+        }
+    }
+    s.searches = 1;
+    s.exhausted = 1;
+    s.comparisons = int64_t(heap.nComps());
+    s.search_ns = now_ns() - start;
+    record(s);
+}
+
+np::ndarray ScenarioDijkstra::get_potentials() const {
+    size_t n = u.size() / max(lanes, 1);
+    np::ndarray arr = np::empty(bp::make_tuple(n, scenarios), np::dtype::get_builtin<float>());
+    float* out = reinterpret_cast<float*>(arr.get_data());
+    for (size_t i = 0; i < n; ++i)
+        copy(&u[i * lanes], &u[i * lanes] + scenarios, out + i * scenarios);
+    return arr;
+}
+
+int ScenarioDijkstra::get_scenarios() const {
+    return scenarios;
+}
@@ -0,0 +1,268 @@
+//
+//  shared.cpp
+//  MyGraph
+//
+
+#include "shared.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[8] = {'P', 'Y', 'D', 'H', 'S', 'G', 'R', '1'};
+
+// at the start of a segment; the offsets are in bytes from there
+struct Header {
+    char magic[8]; // written last, a segment still being filled doesn't attach
+    int32_t n;
+    int32_t m;
+    int32_t turn_cnt;
+    uint32_t vertex_slots;
+    uint32_t edge_slots;
+    uint64_t size;
+    uint64_t out_offset;
+    uint64_t out_edge;
+    uint64_t in_offset;
+    uint64_t in_edge;
+    uint64_t tail;
+    uint64_t head;
+    uint64_t turns;
+    uint64_t wmin;
+    uint64_t wmax;
+    uint64_t vid_offset;
+    uint64_t vid_chars;
+    uint64_t vid_slot;
+    uint64_t eid_offset;
+    uint64_t eid_chars;
+    uint64_t eid_slot;
+};
+
+// FNV-1a
+uint64_t hash_id(const char* _s, size_t _len) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < _len; ++i) {
+        h ^= (unsigned char)_s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// power of two slots, at most half of them in use
+uint32_t slot_count(int _ids) {
+    uint32_t k = 2;
+    while (k < 2 * uint32_t(_ids))
+        k *= 2;
+    return k;
+}
+
+// places arrays one after another on cache line boundaries
+struct Layout {
+    uint64_t at;
+    uint64_t place(uint64_t _bytes) {
+        uint64_t p = at;
+        at = (at + _bytes + 63) & ~uint64_t(63);
+        return p;
+    }
+};
+
+string shm_path(const string &_name) {
+    return !_name.empty() && _name[0] == '/' ? _name : "/" + _name;
+}
+
+template <class T>
+T* at(void* _base, uint64_t _offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(_base) + _offset);
+}
+
+template <class T>
+const T* at(const void* _base, uint64_t _offset) {
+    return reinterpret_cast<const T*>(static_cast<const char*>(_base) + _offset);
+}
+
+// writes the ids of _cnt elements and their lookup table
+template <class IdOf>
+void write_ids(void* _base, uint64_t _offset, uint64_t _chars, uint64_t _slot,
+               uint32_t _slots, int _cnt, IdOf _id_of) {
+    uint64_t* offset = at<uint64_t>(_base, _offset);
+    char* chars = at<char>(_base, _chars);
+    int32_t* slot = at<int32_t>(_base, _slot);
+    memset(slot, 0xff, _slots * sizeof(int32_t));
+    offset[0] = 0;
+    for (int i = 0; i < _cnt; ++i) {
+        const string id = _id_of(i);
+        memcpy(chars + offset[i], id.data(), id.size());
+        offset[i + 1] = offset[i] + id.size();
+        uint32_t k = hash_id(id.data(), id.size()) & (_slots - 1);
+        while (slot[k] >= 0)
+            k = (k + 1) & (_slots - 1);
+        slot[k] = i;
+    }
+}
+
+}
+
+shared_ptr<SharedGraph> SharedGraph::create(const string &_name, Graph &_g,
+                                            const float* _wmin, const float* _wmax) {
+    const Topology &t = _g.get_topology();
+    uint64_t vid_bytes = 0;
+    uint64_t eid_bytes = 0;
+    for (int i = 0; i < t.n; ++i)
+        vid_bytes += _g.get_vid(i).size();
+    for (int i = 0; i < t.m; ++i)
+        eid_bytes += _g.get_eid(i).size();
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    h.n = t.n;
+    h.m = t.m;
+    h.turn_cnt = t.turn_cnt;
+    h.vertex_slots = slot_count(t.n);
+    h.edge_slots = slot_count(t.m);
+    Layout l = {(sizeof(Header) + 63) & ~uint64_t(63)};
+    h.out_offset = l.place((t.n + 1) * sizeof(int));
+    h.out_edge = l.place(t.m * sizeof(int));
+    h.in_offset = l.place((t.n + 1) * sizeof(int));
+    h.in_edge = l.place(t.m * sizeof(int));
+    h.tail = l.place(t.m * sizeof(int));
+    h.head = l.place(t.m * sizeof(int));
+    h.turns = l.place(t.turn_cnt * sizeof(Turn));
+    h.wmin = l.place(t.m * sizeof(float));
+    h.wmax = l.place(t.m * sizeof(float));
+    h.vid_offset = l.place((t.n + 1) * sizeof(uint64_t));
+    h.vid_chars = l.place(vid_bytes);
+    h.vid_slot = l.place(h.vertex_slots * sizeof(int32_t));
+    h.eid_offset = l.place((t.m + 1) * sizeof(uint64_t));
+    h.eid_chars = l.place(eid_bytes);
+    h.eid_slot = l.place(h.edge_slots * sizeof(int32_t));
+    h.size = l.at;
+
+    const string path = shm_path(_name);
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        throw "ERROR: can't create shared memory " + _name + ": " + strerror(errno);
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, h.size) == 0)
+        base = mmap(nullptr, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        throw "ERROR: can't map shared memory " + _name + ": " + strerror(error);
+    }
+
+    memcpy(at<int>(base, h.out_offset), t.out_offset, (t.n + 1) * sizeof(int));
+    memcpy(at<int>(base, h.out_edge), t.out_edge, t.m * sizeof(int));
+    memcpy(at<int>(base, h.in_offset), t.in_offset, (t.n + 1) * sizeof(int));
+    memcpy(at<int>(base, h.in_edge), t.in_edge, t.m * sizeof(int));
+    memcpy(at<int>(base, h.tail), t.tail, t.m * sizeof(int));
+    memcpy(at<int>(base, h.head), t.head, t.m * sizeof(int));
+    if (t.turn_cnt > 0)
+        memcpy(at<Turn>(base, h.turns), t.turns, t.turn_cnt * sizeof(Turn));
+    memcpy(at<float>(base, h.wmin), _wmin, t.m * sizeof(float));
+    memcpy(at<float>(base, h.wmax), _wmax, t.m * sizeof(float));
+    write_ids(base, h.vid_offset, h.vid_chars, h.vid_slot, h.vertex_slots, t.n,
+              [&](int i) { return _g.get_vid(i); });
+    write_ids(base, h.eid_offset, h.eid_chars, h.eid_slot, h.edge_slots, t.m,
+              [&](int i) { return _g.get_eid(i); });
+
+    Header* header = at<Header>(base, 0);
+    *header = h;
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    mprotect(base, h.size, PROT_READ);
+    return shared_ptr<SharedGraph>(new SharedGraph(_name, base, h.size, true));
+}
+
+shared_ptr<SharedGraph> SharedGraph::attach(const string &_name) {
+    int fd = shm_open(shm_path(_name).c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw "ERROR: can't open shared memory " + _name + ": " + strerror(errno);
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header))
+        base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        throw "ERROR: can't map shared memory " + _name;
+    const Header* h = at<Header>(base, 0);
+    if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->size != uint64_t(st.st_size)) {
+        munmap(base, st.st_size);
+        throw "ERROR: no shared graph in " + _name;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return shared_ptr<SharedGraph>(new SharedGraph(_name, base, st.st_size, false));
+}
+
+SharedGraph::SharedGraph(const string &_name, const void* _base, size_t _size, bool _owner)
+    : name(_name), base(_base), size(_size), owner(_owner) {
+    const Header* h = at<Header>(base, 0);
+    topology.n = h->n;
+    topology.m = h->m;
+    topology.out_offset = at<int>(base, h->out_offset);
+    topology.out_edge = at<int>(base, h->out_edge);
+    topology.in_offset = at<int>(base, h->in_offset);
+    topology.in_edge = at<int>(base, h->in_edge);
+    topology.tail = at<int>(base, h->tail);
+    topology.head = at<int>(base, h->head);
+    topology.turns = h->turn_cnt > 0 ? at<Turn>(base, h->turns) : nullptr;
+    topology.turn_cnt = h->turn_cnt;
+    wmin = at<float>(base, h->wmin);
+    wmax = at<float>(base, h->wmax);
+    vertex_ids.offset = at<uint64_t>(base, h->vid_offset);
+    vertex_ids.chars = at<char>(base, h->vid_chars);
+    vertex_ids.slot = at<int32_t>(base, h->vid_slot);
+    vertex_ids.mask = h->vertex_slots - 1;
+    edge_ids.offset = at<uint64_t>(base, h->eid_offset);
+    edge_ids.chars = at<char>(base, h->eid_chars);
+    edge_ids.slot = at<int32_t>(base, h->eid_slot);
+    edge_ids.mask = h->edge_slots - 1;
+}
+
+SharedGraph::~SharedGraph() {
+    unlink();
+    munmap(const_cast<void*>(base), size);
+}
+
+void SharedGraph::unlink() {
+    if (owner) {
+        shm_unlink(shm_path(name).c_str());
+        owner = false;
+    }
+}
+
+int SharedGraph::find(const Ids &_ids, const string &_id) {
+    uint32_t k = hash_id(_id.data(), _id.size()) & _ids.mask;
+    while (true) {
+        int idx = _ids.slot[k];
+        if (idx < 0)
+            return -1;
+        uint64_t begin = _ids.offset[idx];
+        if (_ids.offset[idx + 1] - begin == _id.size()
+                && memcmp(_ids.chars + begin, _id.data(), _id.size()) == 0)
+            return idx;
+        k = (k + 1) & _ids.mask;
+    }
+}
+
+int SharedGraph::find_vertex(const string &_id) const {
+    return find(vertex_ids, _id);
+}
+
+int SharedGraph::find_edge(const string &_id) const {
+    return find(edge_ids, _id);
+}
+
+string SharedGraph::get_vertex_id(int _idx) const {
+    return string(vertex_ids.chars + vertex_ids.offset[_idx],
+                  vertex_ids.offset[_idx + 1] - vertex_ids.offset[_idx]);
+}
+
+string SharedGraph::get_edge_id(int _idx) const {
+    return string(edge_ids.chars + edge_ids.offset[_idx],
+                  edge_ids.offset[_idx + 1] - edge_ids.offset[_idx]);
+}
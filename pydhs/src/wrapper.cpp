@@ -13,6 +13,14 @@
 #include "stdio.h"
 #include "hyperpath.h"
 #include "dijkstra.h"
+#include "assignment.h"
+#include "scenario.h"
+#include "network.h"
+#include "shared.h"
+#include "matsim.h"
+#include "csvload.h"
+#include "linkprofile.h"
+#include "pyhelper.h"
 #include <set>
 #include <boost/python/exception_translator.hpp>
 #include <boost/python/with_custodian_and_ward.hpp>
@@ -85,6 +93,12 @@ void translate_graphnotset(const GraphException::GraphNotSet & e)
 {
     PyErr_SetString(PyExc_RuntimeError, e.what());
 }
+
+// Graph methods throw their error messages as strings
+void translate_message(const std::string & e)
+{
+    PyErr_SetString(PyExc_ValueError, e.c_str());
+}
 // ---------------------------------------------------------
 
 // describe the array by telling number of vertices and edges
@@ -116,6 +130,156 @@ const boost::shared_ptr<Graph> make_graph(const bp::object& array, int n, int m)
     return g;
 }
 
+// graph of a MATSim network.xml with the length and freespeed of its edges
+const bp::tuple load_matsim(const string& path) {
+    vector<float> length;
+    vector<float> freespeed;
+    Graph* g;
+    {
+        ScopedGILRelease nogil;
+        g = load_matsim_graph(path, length, freespeed);
+    }
+    return bp::make_tuple(boost::shared_ptr<Graph>(g), to_ndarray(length), to_ndarray(freespeed));
+}
+
+// graph and weight arrays of an edge list file; columns None for all,
+// header None to guess
+const bp::tuple load_csv(const string& path, const bp::object& columns, const bp::object& header,
+                         const string& delimiter, int threads) {
+    CsvColumns cols;
+    if (!columns.is_none()) {
+        for (int i = 0; i < bp::len(columns); ++i) {
+            bp::extract<int> idx(columns[i]);
+            if (idx.check())
+                cols.index.push_back(idx());
+            else
+                cols.name.push_back(extract<string>(columns[i]));
+        }
+        if (!cols.index.empty() && !cols.name.empty()) {
+            PyErr_SetString(PyExc_ValueError, "columns mix indices and names");
+            bp::throw_error_already_set();
+        }
+    }
+    if (delimiter.size() != 1) {
+        PyErr_SetString(PyExc_ValueError, "delimiter must be one character");
+        bp::throw_error_already_set();
+    }
+    int has_header = header.is_none() ? -1 : int(bool(extract<bool>(header)));
+    vector<vector<float> > weights;
+    Graph* g;
+    {
+        ScopedGILRelease nogil;
+        g = load_csv_graph(path, cols, has_header, delimiter[0], threads, weights);
+    }
+    bp::list out;
+    out.append(boost::shared_ptr<Graph>(g));
+    for (const auto &w : weights)
+        out.append(to_ndarray(w));
+    return bp::tuple(out);
+}
+
+// rows of (from_eid, to_eid) for restrictions or (from_eid, to_eid, penalty)
+void add_turns(Graph* g, const bp::object& array) {
+    for (int i = 0; i < bp::len(array); ++i) {
+        string from_eid = extract<string>(array[i][0]);
+        string to_eid = extract<string>(array[i][1]);
+        if (bp::len(array[i]) < 3) {
+            g->add_turn_restriction(from_eid, to_eid);
+        } else {
+            bp::object v = array[i][2];
+            bp::extract<float> penalty(v);
+            g->add_turn(from_eid, to_eid, penalty.check() ? penalty() : stof(extract<string>(v)()));
+        }
+    }
+}
+
+// ------------ shared memory graphs ----------------------
+// wmax None for deterministic weights
+std::shared_ptr<SharedGraph> share_graph(Graph* g, const string &name, const bp::object &wmin,
+                                         const bp::object &wmax) {
+    size_t m = g->get_edge_number();
+    vector<float> lo = to_floats(wmin, m);
+    vector<float> hi = wmax.is_none() ? lo : to_floats(wmax, m);
+    return SharedGraph::create(name, *g, lo.data(), hi.data());
+}
+
+// a read-only Graph over the segment, no copy made
+const boost::shared_ptr<Graph> shared_graph(const std::shared_ptr<SharedGraph> &s) {
+    return boost::make_shared<Graph>(std::shared_ptr<const GraphStore>(s));
+}
+
+// read-only views of the weights in the segment, keeping it mapped
+np::ndarray shared_weights(const bp::object &self, bool max) {
+    const SharedGraph &s = bp::extract<const SharedGraph&>(self);
+    return np::from_data(max ? s.get_wmax() : s.get_wmin(), np::dtype::get_builtin<float>(),
+                         bp::make_tuple(s.get_topology().m), bp::make_tuple(sizeof(float)), self);
+}
+
+np::ndarray shared_wmin(const bp::object &self) { return shared_weights(self, false); }
+np::ndarray shared_wmax(const bp::object &self) { return shared_weights(self, true); }
+
+// pickled by name, so a handle passed to another process attaches there
+struct shared_graph_pickle_suite : boost::python::pickle_suite
+{
+    static boost::python::tuple
+    getinitargs(SharedGraph const& s) { return boost::python::make_tuple(s.get_name()); }
+};
+
+// a profile of g from a csv, through the cache file when given; fill is
+// one weight for every edge without a row, or one per edge
+std::shared_ptr<LinkProfile> load_profile(Graph& g, const string& path, const bp::object& cache,
+                                          const bp::object& fill, const string& delimiter,
+                                          int threads) {
+    if (delimiter.size() != 1) {
+        PyErr_SetString(PyExc_ValueError, "delimiter must be one character");
+        bp::throw_error_already_set();
+    }
+    const string cache_path = cache.is_none() ? string() : extract<string>(cache);
+    vector<float> fill_weights;
+    if (!fill.is_none()) {
+        bp::extract<float> x(fill);
+        if (x.check())
+            fill_weights.assign(g.get_edge_number(), x());
+        else
+            fill_weights = to_floats(fill, g.get_edge_number());
+    }
+    LinkProfile* p;
+    {
+        ScopedGILRelease nogil;
+        p = load_link_profile(g, path, cache_path, fill.is_none() ? nullptr : fill_weights.data(),
+                              delimiter[0], threads);
+    }
+    return std::shared_ptr<LinkProfile>(p);
+}
+
+// views into the profile, keeping it alive
+np::ndarray profile_matrix(const bp::object &self) {
+    LinkProfile &p = bp::extract<LinkProfile&>(self);
+    return np::from_data(p.column(0), np::dtype::get_builtin<float>(),
+                         bp::make_tuple(p.get_m(), p.get_bins()),
+                         bp::make_tuple(sizeof(float), sizeof(float) * p.get_m()), self);
+}
+
+np::ndarray profile_weights_at(const bp::object &self, float t) {
+    LinkProfile &p = bp::extract<LinkProfile&>(self);
+    return np::from_data(p.column(p.bin_at(t)), np::dtype::get_builtin<float>(),
+                         bp::make_tuple(p.get_m()), bp::make_tuple(sizeof(float)), self);
+}
+
+np::ndarray profile_times(const LinkProfile &p) {
+    vector<float> t(p.get_bins());
+    for (int k = 0; k < p.get_bins(); ++k)
+        t[k] = p.get_t0() + k * p.get_bin_width();
+    return to_ndarray(t);
+}
+
+// stats of the last call and their running total, of any engine
+template <class T>
+bp::dict last_stats(const T &a) { return to_dict(a.get_stats()); }
+
+template <class T>
+bp::dict total_stats(const T &a) { return to_dict(a.get_total_stats()); }
+
 BOOST_PYTHON_MODULE(dhs)
 {
     // disable C++ auto docstring, keep user-defined docstring and C++ signature
@@ -124,9 +288,13 @@ BOOST_PYTHON_MODULE(dhs)
     // keep user-defined docstring only
     docstring_options local_docstring_options(true, false, false);
 
+    // numpy C-API, needed by every method returning an ndarray
+    boost::python::numpy::initialize();
+
     // Register exceptions
     register_exception_translator<GraphException::NotAccessible>(&translate_notaccessible);
     register_exception_translator<GraphException::GraphNotSet>(&translate_graphnotset);
+    register_exception_translator<std::string>(&translate_message);
 
     /// ************************************************************************
     ///                                 Vertex
@@ -222,6 +390,37 @@ BOOST_PYTHON_MODULE(dhs)
             ">>>g = Graph(2,1)\n"
             ">>>g.add_edge('e1','v1','v2')\n\n"
             "Note: add_edge will create the vertices if not existed\n")
+        .def("add_turn", &Graph::add_turn,
+            "add_turn(from_edge, to_edge, penalty)\n\n"
+            "Add a penalty for turning from one edge into the next\n\n"
+            "Parameters\n"
+            "----------\n"
+            "from_edge, to_edge : string\n"
+            "   names of two edges meeting at a vertex\n"
+            "penalty : float\n"
+            "   non-negative cost added to the turn, inf for a restriction\n\n"
+            "Returns\n"
+            "----------\n"
+            "None\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>g.add_turn('e1','e2',5.0)\n\n"
+            "Note: turns not added are free, adding a turn again replaces it\n")
+        .def("add_turn_restriction", &Graph::add_turn_restriction,
+            "add_turn_restriction(from_edge, to_edge)\n\n"
+            "Ban turning from one edge into the next\n\n"
+            "Parameters\n"
+            "----------\n"
+            "from_edge, to_edge : string\n"
+            "   names of two edges meeting at a vertex\n\n"
+            "Returns\n"
+            "----------\n"
+            "None\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>g.add_turn_restriction('e1','e2')\n")
+        .def("clear_turns", &Graph::clear_turns, "Remove all turn penalties and restrictions")
+        .add_property("turn_num", &Graph::get_turn_number, "Number of turn penalties and restrictions")
         .def_readonly("edge_num", &Graph::get_edge_number, "Number of edges")
         .def_readonly("vertex_num", &Graph::get_vertex_number, "Number of vertices")
         .def("get_vertex", get_vertex_byid, return_value_policy<reference_existing_object>())
@@ -253,6 +452,75 @@ BOOST_PYTHON_MODULE(dhs)
             ">>>arr = [['e1','v1','v2'],['e2','v2','v3']]\n"
             ">>>g = make_graph(arr, *describe(arr))\n");
 
+    def("load_csv", load_csv,
+            (bp::arg("path"), bp::arg("columns")=bp::object(), bp::arg("header")=bp::object(),
+             bp::arg("delimiter")=",", bp::arg("threads")=0),
+            "load_csv(path, columns=None, header=None, delimiter=',', threads=0)\n\n"
+            "Make a graph and its weight arrays from an edge list file\n\n"
+            "The file is memory mapped and cut into chunks at line ends, parsed\n"
+            "in parallel with the GIL released; only building the graph is done\n"
+            "on one thread. Fields are not quoted. A repeated edge id is skipped.\n\n"
+            "Parameters\n"
+            "----------\n"
+            "path : string\n"
+            "columns : list of int or list of string\n"
+            "   eid, fvid and tvid columns, then any number of weight columns, by\n"
+            "   index or header name; None for the first three and every later one\n"
+            "header : bool\n"
+            "   whether the first line is a header, None to take it as one when its\n"
+            "   weight fields aren't numbers\n"
+            "delimiter : string\n"
+            "   one character\n"
+            "threads : int\n"
+            "   number of parsing threads, 0 for all cores\n\n"
+            "Returns\n"
+            "----------\n"
+            "out : tuple (Graph, weights...)\n"
+            "   one float32 array by edge index per weight column\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>g, w_min, w_max = load_csv('Bell_biway.csv')\n"
+            ">>>g, length = load_csv('links.csv', columns=['id', 'from', 'to', 'length'])\n");
+
+    def("load_matsim", load_matsim,
+            "load_matsim(path)\n\n"
+            "Make a graph from the links of a MATSim network.xml\n\n"
+            "The file is streamed in one pass, a block at a time, with the GIL\n"
+            "released; nodes and link attributes other than the ones returned are\n"
+            "skipped. Edge and vertex ids are the link and node ids.\n\n"
+            "Parameters\n"
+            "----------\n"
+            "path : string\n"
+            "   an uncompressed network.xml\n\n"
+            "Returns\n"
+            "----------\n"
+            "out : tuple (Graph, length, freespeed)\n"
+            "   length and freespeed as float32 arrays by edge index\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>g, length, freespeed = load_matsim('network.xml')\n"
+            ">>>alg = Ma2013(g)\n"
+            ">>>alg.set_weights(length / freespeed, 1.5 * length / freespeed)\n");
+
+    def("add_turns", add_turns,
+            "add_turns(g, arr)\n\n"
+            "Add the turn tables of an array to a graph\n\n"
+            "Dijkstra and the run/run_many/load_demand/assign of Ma2013 honour\n"
+            "them by searching over the edges, so a path may pass a vertex twice\n"
+            "to go round a banned turn. The trees of Ma2013.run_tree don't.\n\n"
+            "Parameters\n"
+            "----------\n"
+            "g : Graph type\n"
+            "arr : array-like\n"
+            "   rows of (from_eid, to_eid) for restrictions, or of\n"
+            "   (from_eid, to_eid, penalty)\n\n"
+            "Returns\n"
+            "----------\n"
+            "None\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>add_turns(g, [('e1','e2'), ('e1','e3',5.0)])\n");
+
     def("describe", describe,
             "describe(arr)"
             "Calculate number of vertices and edges from an array\n\n"
@@ -271,6 +539,75 @@ BOOST_PYTHON_MODULE(dhs)
             ">>>describe(arr)\n"
             "[3, 2]\n");
 
+    def("load_demand", load_demand,
+            (bp::arg("g"), bp::arg("wmin"), bp::arg("wmax"), bp::arg("od"), bp::arg("threads")=0),
+            "load_demand(g, wmin, wmax, od, threads=0)\n\n"
+            "Load OD demand onto the edges along the hyperpaths of Ma2013\n\n"
+            "OD pairs are grouped by destination. Each destination needs one\n"
+            "complete backward pass and one forward pass carrying the demand of\n"
+            "all its origins. Destinations are spread over worker threads with\n"
+            "their own flow buffers, merged at the end.\n\n"
+            "Parameters\n"
+            "----------\n"
+            "g : Graph type\n"
+            "wmin, wmax : array-like\n"
+            "   minimum and maximum edge weights\n"
+            "od : array-like\n"
+            "   rows of (origin, destination, volume)\n"
+            "threads : int\n"
+            "   number of worker threads, 0 for all cores\n\n"
+            "Returns\n"
+            "----------\n"
+            "out : ndarray of float64\n"
+            "   flow on each edge, by edge index\n\n"
+            "Note: demand of pairs without a hyperpath is not loaded\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>flow = load_demand(g, w_min, w_max, [('1', '37', 100.0), ('9', '37', 50.0)])\n");
+
+    def("assign", assign_equilibrium,
+            (bp::arg("g"), bp::arg("wmin"), bp::arg("wmax"), bp::arg("capacity"), bp::arg("od"),
+             bp::arg("alpha")=0.15, bp::arg("beta")=4.0, bp::arg("max_iter")=100,
+             bp::arg("tol")=1e-4, bp::arg("threads")=0, bp::arg("flow")=bp::object(),
+             bp::arg("iteration")=0),
+            "assign(g, wmin, wmax, capacity, od, alpha=0.15, beta=4.0, max_iter=100, tol=1e-4, threads=0, flow=None, iteration=0)\n\n"
+            "Hyperpath equilibrium assignment by the method of successive averages\n\n"
+            "Every iteration updates both edge weights with the BPR function\n"
+            "w0 * (1 + alpha * (x / capacity)^beta) of the averaged flows x, loads\n"
+            "the demand as load_demand does and averages the new flows y in with\n"
+            "step 1/k, k being the number of loads averaged so far.\n\n"
+            "Parameters\n"
+            "----------\n"
+            "g : Graph type\n"
+            "wmin, wmax : array-like\n"
+            "   free flow minimum and maximum edge weights\n"
+            "capacity : array-like\n"
+            "   edge capacities, 0 for uncongested edges\n"
+            "od : array-like\n"
+            "   rows of (origin, destination, volume)\n"
+            "alpha, beta : float\n"
+            "   BPR parameters\n"
+            "max_iter : int\n"
+            "   maximum number of iterations\n"
+            "tol : float\n"
+            "   stop once the gap sum|y - x| / sum x falls below tol\n"
+            "threads : int\n"
+            "   number of worker threads, 0 for all cores\n"
+            "flow : array-like, optional\n"
+            "   flows to start from, e.g. those of a previous call\n"
+            "iteration : int\n"
+            "   number of loads averaged into flow, to continue the step sizes\n\n"
+            "Returns\n"
+            "----------\n"
+            "out : dict\n"
+            "   'flow' the edge flows, 'wmin'/'wmax' the weights at those flows\n"
+            "   'gap' the gap of every iteration and 'iteration' the number of\n"
+            "   loads averaged into 'flow'\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>res = assign(g, w_min, w_max, cap, od, max_iter=50)\n"
+            ">>>res = assign(g, w_min, w_max, cap, od, flow=res['flow'], iteration=res['iteration'])\n");
+
     /// ************************************************************************
     ///                Dijkstra for node potential generation
     /// ************************************************************************
@@ -298,6 +635,75 @@ BOOST_PYTHON_MODULE(dhs)
         ">>>alg.recover()\n"
         );
 
+    pyDijkstra.def("set_profile", &Dijkstra::set_profile,
+        (bp::arg("w"), bp::arg("t0"), bp::arg("bin_width"), bp::arg("linear")=false),
+        ">>>alg.set_profile(w, t0, bin_width, linear=False)\n\n"
+        "w is an m*bins array of edge weights sampled at t0 + k * bin_width\n"
+        );
+
+    pyDijkstra.def("run_at", &Dijkstra::run_at,
+        ">>>alg.run_at(oid, t)\n\n"
+        "earliest arrivals departing at t, potentials being travel times\n"
+        );
+
+    pyDijkstra.add_property("reverse", &Dijkstra::get_reverse, &Dijkstra::set_reverse,
+        ">>>alg.reverse = True\n\n"
+        "search the edges backwards without copying the graph: potentials\n"
+        "become distances to oid and get_path lists did first\n"
+        );
+
+    pyDijkstra.add_property("stats", &last_stats<Dijkstra>,
+        ">>>alg.stats['search_ns']\n\n"
+        "counters and ns timings of the last run, keyed as Ma2013.stats\n"
+        );
+
+    pyDijkstra.add_property("total_stats", &total_stats<Dijkstra>,
+        ">>>alg.total_stats\n\n"
+        "stats summed over every run since creation or reset_stats\n"
+        );
+
+    pyDijkstra.def("reset_stats", &Dijkstra::reset_stats,
+        ">>>alg.reset_stats()\n"
+        );
+
+    /// ************************************************************************
+    ///              Dijkstra over several weight scenarios
+    /// ************************************************************************
+    class_<ScenarioDijkstra> pyScenario("ScenarioDijkstra",
+            init<Graph*>(args("g"),"ScenarioDijkstra(g)\n\n"
+                "Shortest path distances under several weight scenarios at once\n\n"
+                "All scenarios of an edge are relaxed together with AVX-512 or AVX2\n"
+                "when the cpu has them. The search is label correcting, a vertex\n"
+                "being scanned again whenever any scenario improves its label.\n"
+                "Turn tables are not supported.\n\n"
+                "Examples\n"
+                "----------\n"
+                ">>>alg = ScenarioDijkstra(g)\n"
+                ">>>alg.set_weights(np.column_stack([w_dry, w_rain, w_truck]))\n"
+                ">>>alg.run('1')\n"
+                ">>>u = alg.potentials\n"));
+
+    pyScenario.def("set_weights", &ScenarioDijkstra::set_weights,
+        ">>>alg.set_weights(w)\n\n"
+        "w is an m*S array with the edge weights of one scenario per column\n"
+        );
+
+    pyScenario.def("run", &ScenarioDijkstra::run,
+        ">>>alg.run('oid')\n"
+        );
+
+    pyScenario.add_property("potentials", &ScenarioDijkstra::get_potentials,
+        "n*S float32 array of distances from the last origin, by vertex index\n");
+
+    pyScenario.add_property("scenarios", &ScenarioDijkstra::get_scenarios,
+        "Number of weight scenarios\n");
+    pyScenario.add_property("stats", &last_stats<ScenarioDijkstra>,
+        "Counters and ns timings of the last run, keyed as Ma2013.stats;\n"
+        "a vertex is scanned again whenever one of its lanes improves\n");
+    pyScenario.add_property("total_stats", &total_stats<ScenarioDijkstra>,
+        "stats summed over every run since creation or reset_stats\n");
+    pyScenario.def("reset_stats", &ScenarioDijkstra::reset_stats, "reset_stats()\n\nZero stats and total_stats\n");
+
     /// ************************************************************************
     ///                                 Hyperpath
     /// ************************************************************************
@@ -324,6 +730,27 @@ BOOST_PYTHON_MODULE(dhs)
 
     pyHyperpath.def("set_potentials", &Hyperpath::set_potentials);
 
+    pyHyperpath.def("cache_potentials", &Hyperpath::cache_potentials,
+        "cache_potentials(capacity)\n\n"
+        "Compute exact node potentials internally instead of using set_potentials\n\n"
+        "Potentials are the wmin distances from the origin of each query. They are\n"
+        "kept in an LRU cache keyed by origin and weight version, so repeated\n"
+        "queries from the same origin skip the computation.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "capacity : int\n"
+        "   number of cached origins, 0 switches back to set_potentials\n\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg = Ma2013(g)\n"
+        ">>>alg.set_weights(w_min, w_max)\n"
+        ">>>alg.cache_potentials(64)\n"
+        ">>>alg.run('v1','v3')\n"
+        );
+
     pyHyperpath.def("run", &Hyperpath::run,
         "run(fv, tv)\n\n"
         "Run algorithm to calculate the exact hyperpath \n\n"
@@ -345,10 +772,500 @@ BOOST_PYTHON_MODULE(dhs)
         ">>>alg.set_potentials(h)"
         ">>>alg.run('v1','v3')\n"
         );
+    pyHyperpath.def("set_approximation", &Hyperpath::set_approximation,
+        (bp::arg("eps")=0.0, bp::arg("k")=0),
+        "set_approximation(eps=0.0, k=0)\n\n"
+        "Search smaller hyperpaths by cutting the choice sets\n\n"
+        "An edge is left out of the choice set of its tail when its share of\n"
+        "the attraction f_a / f_i would fall below eps, or when the set already\n"
+        "holds k edges. The choice possibilities are renormalised over the kept\n"
+        "edges. origin_cost then exceeds the exact expected cost by at most\n"
+        "error_bound. run, run_at, run_many and sample_routes are affected,\n"
+        "the trees of run_tree are always exact. Turn tables are not supported.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "eps : float\n"
+        "   least share of an edge within [0, 1], 0 to keep all\n"
+        "k : int\n"
+        "   most edges per vertex, 0 for no limit\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.set_approximation(eps=0.05, k=3)\n"
+        ">>>alg.run('v1','v3')\n"
+        ">>>alg.origin_cost, alg.error_bound\n"
+        ">>>alg.set_approximation()  # exact again\n"
+        );
+
+    pyHyperpath.def("set_gev", &Hyperpath::set_gev, (bp::arg("theta")=0.0),
+        "set_gev(theta=0.0)\n\n"
+        "Use hyperpath based network GEV choice possibilities\n\n"
+        "The attractive edges are found as before. Over them the expected cost\n"
+        "W_i = -1/theta ln sum f_a/f_i exp(-theta (c_a + W_j)) is taken with the\n"
+        "mean edge cost c_a = (wmin + wmax) / 2, and edge a is chosen at its tail\n"
+        "with f_a/f_i exp(-theta (c_a + W_j - W_i)). A small theta gives the\n"
+        "hyperpath possibilities, a large one the cheapest attractive edges.\n"
+        "run, run_at, run_many and sample_routes are affected, origin_cost\n"
+        "becomes W of the origin. set_approximation and turn tables are not\n"
+        "supported, the trees of run_tree stay Ma2013 ones.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "theta : float\n"
+        "   scale parameter, 0 for the Ma2013 possibilities\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.set_gev(0.5)\n"
+        ">>>offsets, edges, prob, cost = alg.run_many(['v1','v2'], ['v3','v3'])\n"
+        );
+
+    pyHyperpath.def("set_profile", &Hyperpath::set_profile,
+        (bp::arg("wmin"), bp::arg("wmax"), bp::arg("t0"), bp::arg("bin_width"),
+         bp::arg("linear")=false),
+        "set_profile(wmin, wmax, t0, bin_width, linear=False)\n\n"
+        "Set time dependent edge weights for run_at\n\n"
+        "The weights of an edge are sampled at t0 + k * bin_width. A binned\n"
+        "profile keeps each sample until the next one, a linear profile\n"
+        "interpolates between them; both stay constant outside the samples.\n"
+        "Where a weight drops faster than time passes, it is replaced by\n"
+        "waiting for the later departure, so the profiles are FIFO.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "wmin, wmax : array-like\n"
+        "   m*bins arrays of minimum and maximum edge weights\n"
+        "t0 : float\n"
+        "   time of the first sample\n"
+        "bin_width : float\n"
+        "   time between samples\n"
+        "linear : bool\n"
+        "   interpolate linearly instead of binning\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.set_profile(wmin_bins, wmax_bins, 0.0, 900.0)\n"
+        ">>>alg.run_at('v1','v3', 8 * 3600.0)\n"
+        );
+
+    pyHyperpath.def("run_at", &Hyperpath::run_at,
+        "run_at(fv, tv, t)\n\n"
+        "Calculate the hyperpath from fv to tv departing at time t\n\n"
+        "Each edge is weighted at the earliest time it can be entered from fv,\n"
+        "found by a time dependent search over wmin. The same arrival times\n"
+        "serve as node potentials, so set_potentials is not used. Reverse\n"
+        "searches are not supported.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "fv, tv : string\n"
+        "   names of from vertex and to vertex\n"
+        "t : float\n"
+        "   departure time\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.run_at('v1','v3', 8 * 3600.0)\n"
+        ">>>alg.hyperpath\n"
+        );
+
+    pyHyperpath.def("sample_routes", &Hyperpath::sample_routes,
+        (bp::arg("fv"), bp::arg("tv"), bp::arg("k"), bp::arg("seed")=0),
+        "sample_routes(fv, tv, k, seed=0)\n\n"
+        "Draw routes from the hyperpath between fv and tv\n\n"
+        "The hyperpath is computed as by run. The choice possibilities at each\n"
+        "of its vertices are turned into alias tables once, so each step of a\n"
+        "route costs constant time. Turn tables are not supported.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "fv, tv : string\n"
+        "   names of from vertex and to vertex\n"
+        "k : int\n"
+        "   number of routes\n"
+        "seed : int\n"
+        "   seed of the random generator\n"
+        "Returns\n"
+        "----------\n"
+        "out : tuple\n"
+        "   (offsets, edges): int64 offsets of length k + 1 and the int32 edge\n"
+        "   indices of route r at edges[offsets[r]:offsets[r+1]]; a route is\n"
+        "   empty when tv can't be reached\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>offsets, edges = alg.sample_routes('v1','v3', 1000, seed=7)\n"
+        ">>>first = edges[offsets[0]:offsets[1]]\n"
+        );
+
+    pyHyperpath.def("run_many", &Hyperpath::run_many,
+        (bp::arg("origins"), bp::arg("destinations"), bp::arg("threads")=0),
+        "run_many(origins, destinations, threads=0)\n\n"
+        "Calculate the hyperpaths of many OD pairs in parallel\n\n"
+        "OD pairs are spread over a pool of worker threads, each with its own\n"
+        "labels over the shared graph and weights. The GIL is released during\n"
+        "the search.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "origins, destinations : array-like\n"
+        "   vertex names of the OD pairs, of equal length\n"
+        "threads : int\n"
+        "   number of worker threads, 0 for all cores\n\n"
+        "Returns\n"
+        "----------\n"
+        "out : tuple of ndarray (od_offsets, edge_idx, prob, cost)\n"
+        "   the hyperpath of the k-th pair is edge_idx[od_offsets[k]:od_offsets[k+1]]\n"
+        "   with choice possibilities prob[od_offsets[k]:od_offsets[k+1]]\n"
+        "   and expected cost cost[k] of its origin, inf if not accessible\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>offsets, edges, prob, cost = alg.run_many(['v1','v2'], ['v3','v3'], threads=4)\n"
+        );
+
+    pyHyperpath.def("run_tree", &Hyperpath::run_tree,
+        "run_tree(tv)\n\n"
+        "Run the backward pass from a destination to completion\n\n"
+        "The node labels are kept for the destination, so that load() can\n"
+        "compute the hyperpath of any origin with a forward pass only. Node\n"
+        "potentials are not used. The kept labels are dropped by set_weights.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "tv : string\n"
+        "   name of the destination vertex\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.run_tree('v3')\n"
+        ">>>alg.load('v1','v3')\n"
+        ">>>alg.load('v2','v3')\n"
+        );
+
+    pyHyperpath.def("load", &Hyperpath::load,
+        "load(fv, tv)\n\n"
+        "Calculate the hyperpath from fv to tv with the labels kept by run_tree\n\n"
+        "The tree of tv is computed first if it doesn't exist yet.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "fv, tv : string\n"
+        "   names of from vertex and to vertex\n"
+        "Returns\n"
+        "----------\n"
+        "None\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.load('v1','v3')\n"
+        ">>>alg.hyperpath\n"
+        );
+
+    pyHyperpath.def("update_weights", &Hyperpath::update_weights,
+        "update_weights(edges, wmin, wmax)\n\n"
+        "Change the weights of a few edges, keeping the labels of run_tree\n\n"
+        "Only the kept trees the changed edges can affect are repaired, and only\n"
+        "above the cheapest change; the others are served by load as before.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "edges : list of int\n"
+        "   edge indices\n"
+        "wmin, wmax : list of float\n"
+        "   their new weights\n"
+        "Returns\n"
+        "----------\n"
+        "int, number of repaired trees\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.run_tree('v3')\n"
+        ">>>alg.update_weights([4], [12.0], [20.0])\n"
+        ">>>alg.load('v1','v3')\n"
+        );
+
+    pyHyperpath.def("tree_costs", &Hyperpath::get_tree_costs,
+        "tree_costs(tv)\n\n"
+        "Expected costs of all vertices towards tv, from the labels of run_tree\n\n"
+        "The tree of tv is computed first if it doesn't exist yet. In reverse\n"
+        "mode tv is the origin and the costs are those of reaching every\n"
+        "vertex from it.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "tv : string\n"
+        "   name of the root vertex\n"
+        "Returns\n"
+        "----------\n"
+        "ndarray of float32 by vertex index, inf where not accessible\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>alg.reverse = True\n"
+        ">>>u = alg.tree_costs('v1')\n"
+        );
+
+    pyHyperpath.add_property("reverse", &Hyperpath::get_reverse, &Hyperpath::set_reverse,
+            "Search the edges backwards, as on g.reverse() but without a copy\n\n"
+            "Searches and results keep the edge indices of g; a hyperpath from\n"
+            "fv to tv is then one over the edges of g leading from tv to fv.\n"
+            "Changing it drops the kept trees and cached potentials. Turn tables\n"
+            "are not supported.\n");
+
+    pyHyperpath.def("clear_trees", &Hyperpath::clear_trees,
+            "clear_trees() \n\n"
+            "Drop the labels kept by run_tree\n");
+
     pyHyperpath.def_readonly("hyperpath", &Hyperpath::get_hyperpath,
             "Hyperpath result \n\n"
             "Note: the first element is edge index, the second element is choice possibility\n");
 
+    pyHyperpath.add_property("hyperpath_edges", &Hyperpath::get_edges,
+            "Edge indices of the hyperpath result as numpy array\n\n"
+            "Note: same order as hyperpath, use g.get_edge(idx) for the edge\n");
+
+    pyHyperpath.add_property("hyperpath_probs", &Hyperpath::get_probs,
+            "Choice possibilities of hyperpath_edges as numpy array\n");
+
+    pyHyperpath.add_property("origin_cost", &Hyperpath::get_cost,
+            "Expected travel cost u_i of the origin, inf if not accessible\n");
+
+    pyHyperpath.add_property("error_bound", &Hyperpath::get_error_bound,
+            "Most that origin_cost exceeds the exact cost by, 0 unless approximated\n");
+    pyHyperpath.add_property("stats", &last_stats<Hyperpath>,
+            "Counters and monotonic ns timings of the last call that searched\n\n"
+            "A dict of searches, search_ns (backward pass), sort_ns (loading order),\n"
+            "load_ns (forward pass), output_ns (copying the hyperpath out),\n"
+            "vertices_scanned, edges_scanned, inserts, decrease_keys, delete_mins,\n"
+            "comparisons (heap key comparisons), stopped_at_origin and exhausted,\n"
+            "which count how the backward passes ended. run_many sums the searches\n"
+            "of all its workers.\n");
+    pyHyperpath.add_property("total_stats", &total_stats<Hyperpath>,
+            "stats summed over every call since creation or reset_stats\n");
+    pyHyperpath.def("reset_stats", &Hyperpath::reset_stats,
+            "reset_stats()\n\nZero stats and total_stats\n");
+
+    pyHyperpath.def("node_probs", &Hyperpath::get_node_probs,
+            "node_probs()\n\n"
+            "Visit possibilities of the vertices on the hyperpath\n\n"
+            "Returns\n"
+            "----------\n"
+            "out : tuple of ndarray (vertex_idx, prob)\n"
+            "   vertex indices in increasing order, the origin has prob 1.0\n");
+
     pyHyperpath.def("recover", &Hyperpath::recover,
             "recover() \n");
+
+    /// ************************************************************************
+    ///                      Thread-safe network queries
+    /// ************************************************************************
+    class_<Network, boost::noncopyable> pyNetwork("Network",
+            "A graph and a snapshot of its weights that many threads can query at once\n\n"
+            "Unlike Dijkstra and Ma2013, a query doesn't change the object: the labels\n"
+            "of each query come from a pool of workspaces, and the GIL is released\n"
+            "while it runs, so threads of a ThreadPoolExecutor search in parallel.\n"
+            "The graph must not be changed while the network is in use.\n",
+            init<Graph*, bp::object, bp::object, int, int>(
+                (bp::arg("g"), bp::arg("wmin"), bp::arg("wmax")=bp::object(), bp::arg("cache")=0,
+                 bp::arg("threads")=0),
+                "Network(g, wmin, wmax=None, cache=0, threads=0)\n\n"
+                "Parameters\n"
+                "----------\n"
+                "g : Graph type\n"
+                "wmin, wmax : array-like\n"
+                "   minimum and maximum edge weights, wmax None for wmin\n"
+                "cache : int\n"
+                "   origins to keep exact node potentials for, 0 for none\n"
+                "threads : int\n"
+                "   worker threads of submit_run and submit_shortest, 0 for all cores\n\n"
+                "Examples\n"
+                "----------\n"
+                ">>>net = Network(g, w_min, w_max, cache=64)\n"
+                ">>>with ThreadPoolExecutor(8) as ex:\n"
+                ">>>    res = list(ex.map(net.hyperpath, origins, destinations))\n"));
+
+    pyNetwork.def("hyperpath", &Network::hyperpath,
+        "hyperpath(fv, tv)\n\n"
+        "Calculate the hyperpath from fv to tv as Ma2013.run does\n\n"
+        "Parameters\n"
+        "----------\n"
+        "fv, tv : string\n"
+        "   names of from vertex and to vertex\n"
+        "Returns\n"
+        "----------\n"
+        "out : tuple (edge_idx, prob, cost)\n"
+        "   edge indices and choice possibilities as numpy arrays, and the\n"
+        "   expected cost of fv, inf if not accessible\n"
+        );
+
+    pyNetwork.def("shortest", &Network::shortest,
+        "shortest(fv)\n\n"
+        "Shortest wmin distances from fv to every vertex\n\n"
+        "Returns\n"
+        "----------\n"
+        "ndarray of float32 by vertex index, inf where not accessible\n"
+        );
+
+    pyNetwork.def("submit_run", &Network::submit_run,
+        "submit_run(fv, tv)\n\n"
+        "Queue the hyperpath from fv to tv on the worker threads\n\n"
+        "Returns at once. The network's workers search without the GIL and\n"
+        "set the futures of finished queries in batches, taking the GIL once\n"
+        "per batch. Unknown vertices raise here rather than in the future.\n"
+        "The network waits for the queued queries when it is deleted.\n\n"
+        "Returns\n"
+        "----------\n"
+        "concurrent.futures.Future of (edge_idx, prob, cost), as hyperpath\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>futures = [net.submit_run(o, d) for o, d in pairs]\n"
+        ">>>res = [f.result() for f in futures]\n"
+        ">>>res = await asyncio.wrap_future(net.submit_run('1', '37'))\n"
+        );
+
+    pyNetwork.def("submit_shortest", &Network::submit_shortest,
+        "submit_shortest(fv)\n\n"
+        "Queue shortest on the worker threads, as submit_run does\n\n"
+        "Returns\n"
+        "----------\n"
+        "concurrent.futures.Future of an ndarray of float32 by vertex index\n"
+        );
+
+    pyNetwork.def("update", &Network::update,
+        (bp::arg("wmin"), bp::arg("wmax")=bp::object(), bp::arg("edges")=bp::object()),
+        "update(wmin, wmax=None, edges=None)\n\n"
+        "Publish new edge weights without stopping queries\n\n"
+        "A new snapshot is built and swapped in atomically. Queries already\n"
+        "running finish on the weights they started with, later ones use the\n"
+        "new weights. The GIL is released while the snapshot is built.\n\n"
+        "Parameters\n"
+        "----------\n"
+        "wmin, wmax : array-like\n"
+        "   new weights, wmax None for wmin\n"
+        "edges : list of int\n"
+        "   indices of the edges wmin and wmax are for, None for all edges\n"
+        "Returns\n"
+        "----------\n"
+        "int, the new version\n\n"
+        "Examples\n"
+        "----------\n"
+        ">>>net.update([12.0], [20.0], edges=[4])\n"
+        );
+
+    pyNetwork.add_property("version", &Network::get_version,
+            "Version of the current weights, counting updates\n");
+
+    pyNetwork.add_property("workspaces", &Network::get_workspaces,
+            "Number of workspaces created, the most queries run at once so far\n");
+    pyNetwork.add_property("total_stats", &total_stats<Network>,
+            "Counters and ns timings summed over every hyperpath answered, as the\n"
+            "stats of Ma2013\n");
+    pyNetwork.def("reset_stats", &Network::reset_stats, "reset_stats()\n\nZero total_stats\n");
+
+    /// ************************************************************************
+    ///                      Graphs in shared memory
+    /// ************************************************************************
+    class_<SharedGraph, std::shared_ptr<SharedGraph>, boost::noncopyable> pySharedGraph("SharedGraph",
+            "A graph and its weights in a POSIX shared memory segment\n\n"
+            "share_graph copies them in once; other processes attach by name,\n"
+            "which maps the segment without copying or parsing anything, and build\n"
+            "Dijkstra, Ma2013 or Network on its graph. A pool of processes then\n"
+            "holds one copy of the network rather than one each. The segment is\n"
+            "read-only once created, and removed when the handle returned by\n"
+            "share_graph goes away or unlink is called.\n",
+            no_init);
+    pySharedGraph.def("__init__", make_constructor(&SharedGraph::attach, default_call_policies(),
+                (bp::arg("name"))),
+            "SharedGraph(name)\n\n"
+            "Attach to the segment created by share_graph under name\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>sg = SharedGraph('dhs_net')\n"
+            ">>>alg = Ma2013(sg.graph)\n"
+            ">>>alg.set_weights(sg.wmin, sg.wmax)\n");
+    pySharedGraph.def_pickle(shared_graph_pickle_suite());
+    pySharedGraph.add_property("graph", &shared_graph,
+            "Read-only Graph over the segment; it has no Vertex and Edge objects\n");
+    pySharedGraph.add_property("wmin", &shared_wmin, "Read-only float32 view of the minimum weights\n");
+    pySharedGraph.add_property("wmax", &shared_wmax, "Read-only float32 view of the maximum weights\n");
+    pySharedGraph.add_property("name", make_function(&SharedGraph::get_name,
+                return_value_policy<copy_const_reference>()), "Name of the segment\n");
+    pySharedGraph.add_property("nbytes", &SharedGraph::get_size, "Size of the segment in bytes\n");
+    pySharedGraph.add_property("owner", &SharedGraph::is_owner,
+            "Whether this handle removes the segment when it goes away\n");
+    pySharedGraph.def("unlink", &SharedGraph::unlink,
+            "unlink()\n\n"
+            "Remove the segment's name; mapped handles keep working, new attaches fail\n");
+
+    def("share_graph", share_graph,
+            (bp::arg("g"), bp::arg("name"), bp::arg("wmin"), bp::arg("wmax")=bp::object()),
+            "share_graph(g, name, wmin, wmax=None)\n\n"
+            "Copy a graph and its weights into a new shared memory segment\n\n"
+            "Parameters\n"
+            "----------\n"
+            "g : Graph type\n"
+            "name : string\n"
+            "   name of the segment, which must not exist yet\n"
+            "wmin, wmax : array-like\n"
+            "   minimum and maximum edge weights, wmax None for wmin\n\n"
+            "Returns\n"
+            "----------\n"
+            "SharedGraph type, owning the segment\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>sg = share_graph(g, 'dhs_net', w_min, w_max)\n"
+            ">>>with multiprocessing.Pool(32, init, (sg,)) as pool:\n"
+            ">>>    pool.map(work, jobs)\n");
+    /// ************************************************************************
+    ///                      Time-of-day link profiles
+    /// ************************************************************************
+    class_<LinkProfile, std::shared_ptr<LinkProfile>, boost::noncopyable> pyLinkProfile("LinkProfile",
+            "Time-of-day weights of every edge of a graph\n\n"
+            "One dense float32 matrix of edge idx x time bin, made by load_profile.\n"
+            "The weights of one bin are contiguous, so weights_at views them\n"
+            "without a copy and set_weights takes them in a single memcpy.\n",
+            no_init);
+    pyLinkProfile.add_property("matrix", &profile_matrix,
+            "float32 view of the weights, one row per edge idx and one column per bin\n");
+    pyLinkProfile.add_property("times", &profile_times, "Start time of every bin in seconds\n");
+    pyLinkProfile.add_property("bins", &LinkProfile::get_bins, "Number of time bins\n");
+    pyLinkProfile.add_property("t0", &LinkProfile::get_t0, "Time of the first bin\n");
+    pyLinkProfile.add_property("bin_width", &LinkProfile::get_bin_width, "Seconds between bins\n");
+    pyLinkProfile.def("bin_at", &LinkProfile::bin_at,
+            "bin_at(t)\n\n"
+            "The bin time t falls in, the first or last one outside the profile\n");
+    pyLinkProfile.def("weights_at", &profile_weights_at,
+            "weights_at(t)\n\n"
+            "float32 view of the weights of every edge in the bin of time t\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>alg.set_weights(p.weights_at(8 * 3600), w_max)\n");
+
+    def("load_profile", load_profile,
+            (bp::arg("g"), bp::arg("path"), bp::arg("cache")=bp::object(), bp::arg("fill")=bp::object(),
+             bp::arg("delimiter")=",", bp::arg("threads")=0),
+            "load_profile(g, path, cache=None, fill=None, delimiter=',', threads=0)\n\n"
+            "Read the time-of-day edge weights of a graph\n\n"
+            "The csv has a header of an empty field and the bin times in seconds,\n"
+            "equally spaced, then rows of an edge id and one weight per bin. Rows of\n"
+            "edges not in g are skipped. With a cache file the matrix is saved after\n"
+            "reading the csv and read back from it as long as the csv and the edges of\n"
+            "g are unchanged.\n\n"
+            "Parameters\n"
+            "----------\n"
+            "g : Graph type\n"
+            "path : string\n"
+            "cache : string\n"
+            "   binary cache file, None for none\n"
+            "fill : float or array-like\n"
+            "   weight of edges without a row, in every bin; None makes them an error\n"
+            "delimiter : string\n"
+            "   one character\n"
+            "threads : int\n"
+            "   number of parsing threads, 0 for all cores\n\n"
+            "Returns\n"
+            "----------\n"
+            "LinkProfile type\n\n"
+            "Examples\n"
+            "----------\n"
+            ">>>p = load_profile(g, 'maxdelay.csv', cache='maxdelay.bin', fill=w_min)\n"
+            ">>>alg.set_weights(p.weights_at(8 * 3600), w_max)\n"
+            ">>>alg.set_profile(p.matrix, p.matrix, p.t0, p.bin_width)\n");
 }
@@ -1,4 +1,5 @@
 import os
+import sys
 from setuptools import setup
 from setuptools import Extension
 print('This module requires libboost-python-dev, libpython-dev')
@@ -11,7 +12,9 @@ if os.environ.get('LD_LIBRARY_PATH'):
 
 config['include_path'] = config.get('include_path') + ['pydhs/header', ]
 
-libraries = ['python3.8', 'boost_python3.8']
+libraries = ['python3.8', 'boost_python3.8', 'boost_numpy3.8']
+if sys.platform.startswith('linux'):
+    libraries.append('rt')  # shm_open before glibc 2.34
 
 classifiers = [
     'Development Status :: 3 - Alpha',
@@ -27,7 +30,8 @@ classifiers = [
 dhs = Extension('dhs',
                 sources=['pydhs/src/' + i for i in os.listdir('pydhs/src') if i.endswith('cpp')],
                 define_macros=[('MAJOR_VERSION', '1'), ('MINOR_VERSION', '6')],
-                extra_compile_args=['-std=c++11'],
+                extra_compile_args=['-std=c++11', '-pthread'],
+                extra_link_args=['-pthread'],
                 include_dirs=config.get('include_path'),
                 library_dirs=config.get('libarary_path'),
                 libraries=libraries)
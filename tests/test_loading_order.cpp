@@ -0,0 +1,148 @@
+//
+//  test_loading_order.cpp
+//  MyGraph
+//
+//  Regression test of the loading order under tied keys. On a grid with
+//  integer weights and the exact potentials of lower_bounds, an edge into a
+//  vertex often has the same key as an attractive edge out of it. For every
+//  OD pair the hyperpath must conserve flow and give the probabilities of
+//  loading in decreasing u_i[j] + wmin, and the GEV cost of the origin must
+//  not depend on the potentials.
+//
+//  g++ -std=c++11 -O2 -pthread -Ipydhs/header tests/test_loading_order.cpp
+//      pydhs/src/hyperpath_search.cpp pydhs/src/potential.cpp
+//      pydhs/src/fibheap.cpp -o test_loading_order && ./test_loading_order
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include "graph.h"
+#include "hyperpath_search.h"
+#include "potential.h"
+#include "sampler.h"
+
+#define LARGENUMBER 9999999999
+
+const int N = 8;
+
+static int failures = 0;
+
+static void check(bool _ok, const string &_what, int _o, int _d) {
+    if (_ok)
+        return;
+    if (failures < 10)
+        cerr << _what << " from " << _o << " to " << _d << endl;
+    failures++;
+}
+
+// bidirectional N x N grid, wmin in 1..3 and wmax 1..2 above it
+static Graph* make_grid(vector<float> &_wmin, vector<float> &_wmax) {
+    SplitMix64 rng(7);
+    Graph* g = new Graph(N * N, 4 * N * (N - 1));
+    for (int v = 0; v < N * N; ++v)
+        g->add_vertex(to_string(v));
+    int e = 0;
+    for (int r = 0; r < N; ++r) {
+        for (int c = 0; c < N; ++c) {
+            int v = r * N + c;
+            int next[2] = {c + 1 < N ? v + 1 : -1, r + 1 < N ? v + N : -1};
+            for (const auto &u : next) {
+                if (u < 0)
+                    continue;
+                for (int k = 0; k < 2; ++k) {
+                    g->add_edge(to_string(e++), to_string(k ? u : v), to_string(k ? v : u));
+                    float w = float(1 + rng.next() % 3);
+                    _wmin.push_back(w);
+                    _wmax.push_back(w + float(1 + rng.next() % 2));
+                }
+            }
+        }
+    }
+    return g;
+}
+
+// inflow less outflow of every vertex is -1 at _o, 1 at _d and 0 elsewhere
+static bool conserves(const Topology &_t, const float* _p_a, int _o, int _d, float _tol) {
+    for (int v = 0; v < _t.n; ++v) {
+        double net = 0;
+        for (int k = _t.in_offset[v]; k < _t.in_offset[v + 1]; ++k)
+            net += _p_a[_t.in_edge[k]];
+        for (int k = _t.out_offset[v]; k < _t.out_offset[v + 1]; ++k)
+            net -= _p_a[_t.out_edge[k]];
+        double expected = v == _o ? -1 : v == _d ? 1 : 0;
+        if (fabs(net - expected) > _tol)
+            return false;
+    }
+    return true;
+}
+
+// the forward pass of the labels left in _ws over its attractive edges
+// sorted by decreasing u_i[j] + wmin, as loading was done before the
+// settle order was reused
+static vector<float> sorted_loading(const Topology &_t, const HyperpathWeights &_w,
+                                    const HyperpathWorkspace &_ws, int _o) {
+    const float* u_i = _ws.u_i.data();
+    vector<int> po_edges = _ws.po_edges;
+    sort(po_edges.begin(), po_edges.end(),
+            [&](int a, int b)->bool
+            {
+            return u_i[_t.head[a]] + _w.wmin[a] > u_i[_t.head[b]] + _w.wmin[b];
+            });
+    vector<float> p_i(_t.n, 0.0);
+    vector<float> p_a(_t.m, 0.0);
+    p_i[_o] = 1.0;
+    for (const auto &a_idx : po_edges) {
+        int i_idx = _t.tail[a_idx];
+        if (p_i[i_idx] == 0)
+            continue;
+        float w_max = _w.wmax[a_idx];
+        float w_min = _w.wmin[a_idx];
+        float f_a = w_max == w_min ? LARGENUMBER : 1.0 / (w_max - w_min);
+        float P_a = f_a / _ws.f_i[i_idx];
+        p_a[a_idx] = P_a * p_i[i_idx];
+        p_i[_t.head[a_idx]] += p_a[a_idx];
+    }
+    return p_a;
+}
+
+int main() {
+    vector<float> wmin;
+    vector<float> wmax;
+    unique_ptr<Graph> g(make_grid(wmin, wmax));
+    const Topology &t = g->get_topology();
+    HyperpathWorkspace ws(t.n, t.m);
+    vector<float> h(t.n);
+    HyperpathWeights exact;
+    exact.wmin = wmin.data();
+    exact.wmax = wmax.data();
+    exact.h = h.data();
+    HyperpathWeights none = exact;
+    none.h = nullptr;
+
+    int queries = 0;
+    for (int o = 0; o < t.n; ++o) {
+        lower_bounds(t, wmin.data(), o, h.data());
+        for (int d = 0; d < t.n; ++d) {
+            if (d == o)
+                continue;
+            queries++;
+            hyperpath_search(t, exact, o, d, ws);
+            check(conserves(t, ws.p_a.data(), o, d, 1e-4f), "flow not conserved", o, d);
+            vector<float> p_a = sorted_loading(t, exact, ws, o);
+            check(equal(p_a.begin(), p_a.end(), ws.p_a.begin()),
+                  "probabilities differ from the sorted order", o, d);
+
+            hyperpath_gev(t, exact, 0.5, o, d, ws);
+            float cost = ws.u_i[o];
+            check(conserves(t, ws.p_a.data(), o, d, 1e-3f), "GEV flow not conserved", o, d);
+            hyperpath_gev(t, none, 0.5, o, d, ws);
+            check(fabs(cost - ws.u_i[o]) <= 1e-4f * max(1.0f, fabs(cost)),
+                  "GEV cost depends on the potentials", o, d);
+        }
+    }
+    cout << queries << " queries, " << failures << " failures" << endl;
+    return failures == 0 ? 0 : 1;
+}
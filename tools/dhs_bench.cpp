@@ -0,0 +1,460 @@
+//
+//  dhs_bench.cpp
+//  MyGraph
+//
+//  Benchmarks of graph construction, set_weights, Dijkstra with each heap
+//  and the hyperpath search, on generated or local networks, without
+//  Python. Every random choice comes from --seed, so two runs on one machine
+//  measure the same work; the results are written as one JSON object.
+//
+//  dhs_bench [--grid RxC]... [--geometric N]... [--dimacs FILE]...
+//            [--network FILE]... [--queries Q] [--reps R] [--spread S]
+//            [--seed S] [--out FILE]
+//
+//  --grid       bidirectional R x C grid as the Bell (2009) sample network,
+//               wmin uniform in [1, 2)
+//  --geometric  N points in a square of density 1, each linked both ways to
+//               its 3 nearest neighbours, wmin 10 per unit of length
+//  --dimacs     a 9th DIMACS challenge .gr file, its arc lengths as wmin
+//  --network    a csv of id, from, to, ..., wmin, wmax as for dhs_server
+//  --spread     wmax = wmin * (1 + spread * U[0, 1)) where it isn't given
+//  With no network given, --grid 100x100 --geometric 10000 are run.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include "protocol.h"
+#include "graph.h"
+#include "fibheap.h"
+#include "radixheap.h"
+#include "heap.h"
+#include "dijkstra_search.h"
+#include "hyperpath_search.h"
+#include "potential.h"
+#include "sampler.h"
+#include "weights.h"
+
+struct Network {
+    string name;
+    vector<NetworkRow> rows;
+};
+
+struct Options {
+    int queries;
+    int reps;
+    float spread;
+    uint64_t seed;
+};
+
+static float spread_weight(float _wmin, float _spread, SplitMix64 &_rng) {
+    return _wmin * float(1.0 + _spread * _rng.uniform());
+}
+
+static void add_row(Network &_net, int _from, int _to, float _wmin, float _wmax) {
+    NetworkRow row;
+    row.id = to_string(_net.rows.size() + 1);
+    row.from = to_string(_from);
+    row.to = to_string(_to);
+    row.wmin = _wmin;
+    row.wmax = _wmax;
+    _net.rows.push_back(row);
+}
+
+static Network make_grid(int _rows, int _cols, const Options &_opt, SplitMix64 &_rng) {
+    Network net;
+    net.name = "grid_" + to_string(_rows) + "x" + to_string(_cols);
+    for (int r = 0; r < _rows; ++r) {
+        for (int c = 0; c < _cols; ++c) {
+            int v = r * _cols + c + 1;
+            if (c + 1 < _cols) {
+                for (int k = 0; k < 2; ++k) {
+                    float w = float(1.0 + _rng.uniform());
+                    add_row(net, k ? v + 1 : v, k ? v : v + 1, w, spread_weight(w, _opt.spread, _rng));
+                }
+            }
+            if (r + 1 < _rows) {
+                for (int k = 0; k < 2; ++k) {
+                    float w = float(1.0 + _rng.uniform());
+                    add_row(net, k ? v + _cols : v, k ? v : v + _cols, w,
+                            spread_weight(w, _opt.spread, _rng));
+                }
+            }
+        }
+    }
+    return net;
+}
+
+// points bucketed into unit cells; the neighbours of a point are searched
+// ring by ring until no nearer one can be left
+static Network make_geometric(int _n, const Options &_opt, SplitMix64 &_rng) {
+    const int k = 3;
+    const int side = max(1, int(ceil(sqrt(double(_n)))));
+    vector<double> x(_n);
+    vector<double> y(_n);
+    vector<vector<int> > cells(size_t(side) * side);
+    for (int i = 0; i < _n; ++i) {
+        x[i] = _rng.uniform() * side;
+        y[i] = _rng.uniform() * side;
+        cells[size_t(min(int(y[i]), side - 1)) * side + min(int(x[i]), side - 1)].push_back(i);
+    }
+    vector<pair<int, int> > links;
+    vector<pair<double, int> > near;
+    for (int i = 0; i < _n; ++i) {
+        int cx = min(int(x[i]), side - 1);
+        int cy = min(int(y[i]), side - 1);
+        near.clear();
+        for (int ring = 0; ring < side; ++ring) {
+            for (int gy = cy - ring; gy <= cy + ring; ++gy) {
+                for (int gx = cx - ring; gx <= cx + ring; ++gx) {
+                    if (gx < 0 || gy < 0 || gx >= side || gy >= side
+                        || max(abs(gx - cx), abs(gy - cy)) != ring)
+                        continue;
+                    for (const auto &j : cells[size_t(gy) * side + gx]) {
+                        if (j != i)
+                            near.push_back(make_pair(hypot(x[i] - x[j], y[i] - y[j]), j));
+                    }
+                }
+            }
+            // points beyond this ring are at least ring units away
+            if (int(near.size()) >= k) {
+                nth_element(near.begin(), near.begin() + (k - 1), near.end());
+                if (near[k - 1].first <= ring)
+                    break;
+            }
+        }
+        sort(near.begin(), near.end());
+        for (int j = 0; j < k && j < int(near.size()); ++j)
+            links.push_back(make_pair(min(i, near[j].second), max(i, near[j].second)));
+    }
+    sort(links.begin(), links.end());
+    links.erase(unique(links.begin(), links.end()), links.end());
+
+    Network net;
+    net.name = "geometric_" + to_string(_n);
+    for (const auto &l : links) {
+        float w = float(10 * hypot(x[l.first] - x[l.second], y[l.first] - y[l.second]));
+        add_row(net, l.first + 1, l.second + 1, w, spread_weight(w, _opt.spread, _rng));
+        add_row(net, l.second + 1, l.first + 1, w, spread_weight(w, _opt.spread, _rng));
+    }
+    return net;
+}
+
+// "a u v w" lines of a .gr file; comments and the problem line are skipped
+static bool read_dimacs(const string &_path, const Options &_opt, SplitMix64 &_rng,
+                        Network &_net) {
+    FILE* f = fopen(_path.c_str(), "r");
+    if (!f)
+        return false;
+    _net.name = _path;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        int u;
+        int v;
+        double w;
+        if (line[0] == 'a' && sscanf(line + 1, "%d %d %lf", &u, &v, &w) == 3)
+            add_row(_net, u, v, float(w), spread_weight(float(w), _opt.spread, _rng));
+    }
+    fclose(f);
+    return true;
+}
+
+// ns of single operations
+class Samples {
+public:
+    void add(int64_t _ns) { ns.push_back(_ns); }
+
+    // "runs", "mean_ns", ... members of a JSON object
+    string json() {
+        if (ns.empty())
+            return "\"runs\":0";
+        sort(ns.begin(), ns.end());
+        double total = 0;
+        for (const auto &x : ns)
+            total += x;
+        return "\"runs\":" + to_string(ns.size())
+            + ",\"mean_ns\":" + to_string(int64_t(total / ns.size()))
+            + ",\"p50_ns\":" + to_string(ns[ns.size() / 2])
+            + ",\"p90_ns\":" + to_string(ns[ns.size() * 9 / 10])
+            + ",\"min_ns\":" + to_string(ns.front())
+            + ",\"max_ns\":" + to_string(ns.back());
+    }
+
+private:
+    vector<int64_t> ns;
+};
+
+static string stats_json(const SearchStats &_s) {
+    return "{\"searches\":" + to_string(_s.searches)
+        + ",\"search_ns\":" + to_string(_s.search_ns)
+        + ",\"sort_ns\":" + to_string(_s.sort_ns)
+        + ",\"load_ns\":" + to_string(_s.load_ns)
+        + ",\"vertices_scanned\":" + to_string(_s.vertices_scanned)
+        + ",\"edges_scanned\":" + to_string(_s.edges_scanned)
+        + ",\"inserts\":" + to_string(_s.inserts)
+        + ",\"decrease_keys\":" + to_string(_s.decrease_keys)
+        + ",\"delete_mins\":" + to_string(_s.delete_mins)
+        + ",\"comparisons\":" + to_string(_s.comparisons)
+        + ",\"stopped_at_origin\":" + to_string(_s.stopped_at_origin)
+        + ",\"exhausted\":" + to_string(_s.exhausted) + "}";
+}
+
+static Graph* build(const Network &_net) {
+    const size_t m = _net.rows.size();
+    Graph* g = new Graph(int(2 * m), int(m));
+    for (const auto &r : _net.rows)
+        g->add_edge(r.id, r.from, r.to);
+    g->get_topology();
+    return g;
+}
+
+// Dijkstra::run over any heap, dijkstra_search from each origin and
+// dijkstra_recover after it
+template <class H>
+static string bench_dijkstra(const char* _name, const Topology &_t, const float* _w,
+                             const vector<int> &_origins) {
+    const size_t n = _t.n;
+    vector<float> u(n);
+    vector<int> pre_idx(n);
+    vector<int> last_e(n);
+    unique_ptr<bool[]> open(new bool[n]);
+    unique_ptr<bool[]> close(new bool[n]);
+    DijkstraLabels labels;
+    labels.u = u.data();
+    labels.pre_idx = pre_idx.data();
+    labels.open = open.get();
+    labels.close = close.get();
+    labels.last_e = last_e.data();
+    dijkstra_recover(n, labels);
+    SearchStats stats;
+    Samples search;
+    Samples recover;
+    for (const auto &o : _origins) {
+        int64_t start = now_ns();
+        {
+            H heap(n);
+            dijkstra_search(_t, _w, o, heap, labels, stats);
+        }
+        search.add(now_ns() - start);
+        start = now_ns();
+        dijkstra_recover(n, labels);
+        recover.add(now_ns() - start);
+    }
+    return "{\"name\":" + json_quote(_name) + "," + search.json()
+        + ",\"recover\":{" + recover.json() + "},\"stats\":" + stats_json(stats) + "}";
+}
+
+// the largest finite distance from _o_idx, to keep the radix heap within
+// its key range
+static float farthest(const Topology &_t, const float* _w, int _o_idx) {
+    vector<float> u(_t.n);
+    lower_bounds(_t, _w, _o_idx, u.data());
+    float x = 0;
+    for (const auto &d : u) {
+        if (d != numeric_limits<float>::infinity())
+            x = max(x, d);
+    }
+    return x;
+}
+
+static string bench_network(const Network &_net, const Options &_opt) {
+    SplitMix64 rng(_opt.seed);
+    string out = "{\"name\":" + json_quote(_net.name);
+
+    Samples construction;
+    unique_ptr<Graph> g;
+    for (int r = 0; r < _opt.reps; ++r) {
+        g.reset();
+        int64_t start = now_ns();
+        g.reset(build(_net));
+        construction.add(now_ns() - start);
+    }
+    const Topology &t = g->get_topology();
+    out += ",\"n\":" + to_string(t.n) + ",\"m\":" + to_string(t.m) + ",\"results\":[";
+    out += "{\"name\":\"build\"," + construction.json() + "}";
+
+    // weights by edge idx
+    vector<float> wmin(t.m);
+    vector<float> wmax(t.m);
+    for (const auto &r : _net.rows) {
+        int a = g->get_eidx(r.id);
+        wmin[a] = r.wmin;
+        wmax[a] = r.wmax;
+    }
+
+    // set_weights of a float32 array: one memcpy when it's contiguous, float
+    // by float when strided, as a column of an m x 2 matrix
+    vector<float> engine(t.m);
+    vector<float> matrix(2 * size_t(t.m));
+    for (int a = 0; a < t.m; ++a) {
+        matrix[2 * a] = wmin[a];
+        matrix[2 * a + 1] = wmax[a];
+    }
+    Samples contiguous;
+    Samples strided;
+    for (int r = 0; r < _opt.reps * 20; ++r) {
+        int64_t start = now_ns();
+        copy_weights(reinterpret_cast<const char*>(wmin.data()), sizeof(float), engine.data(), t.m);
+        contiguous.add(now_ns() - start);
+        start = now_ns();
+        copy_weights(reinterpret_cast<const char*>(matrix.data()), 2 * sizeof(float),
+                     engine.data(), t.m);
+        strided.add(now_ns() - start);
+    }
+    out += ",{\"name\":\"set_weights\"," + contiguous.json() + "}";
+    out += ",{\"name\":\"set_weights_strided\"," + strided.json() + "}";
+
+    vector<int> origins(_opt.queries);
+    vector<int> destinations(_opt.queries);
+    for (int q = 0; q < _opt.queries; ++q) {
+        origins[q] = int(rng.next() % t.n);
+        destinations[q] = int(rng.next() % t.n);
+    }
+
+    out += "," + bench_dijkstra<FHeap>("dijkstra_fheap", t, wmin.data(), origins);
+    float reach = 0;
+    for (const auto &o : origins)
+        reach = max(reach, farthest(t, wmin.data(), o));
+    // the radix heap orders integer keys up to 500000; fractional keys are
+    // only ordered to within 1
+    if (reach < 500000)
+        out += "," + bench_dijkstra<RadixHeap>("dijkstra_radix", t, wmin.data(), origins);
+    else
+        out += ",{\"name\":\"dijkstra_radix\",\"skipped\":\"distances exceed the radix heap keys\"}";
+
+    // Ma2013.run: no potentials, then with the exact ones of cache_potentials
+    HyperpathWorkspace ws(t.n, t.m);
+    HyperpathWeights w;
+    w.wmin = wmin.data();
+    w.wmax = wmax.data();
+    w.h = nullptr;
+    vector<float> h(t.n);
+    for (int exact = 0; exact < 2; ++exact) {
+        Samples search;
+        Samples recover;
+        Samples potentials;
+        int reachable = 0;
+        ws.stats.clear();
+        for (int q = 0; q < _opt.queries; ++q) {
+            if (exact) {
+                int64_t start = now_ns();
+                lower_bounds(t, wmin.data(), origins[q], h.data());
+                potentials.add(now_ns() - start);
+                w.h = h.data();
+            }
+            int64_t start = now_ns();
+            hyperpath_search(t, w, origins[q], destinations[q], ws);
+            search.add(now_ns() - start);
+            reachable += ws.u_i[origins[q]] != numeric_limits<float>::infinity();
+            start = now_ns();
+            ws.recover();
+            recover.add(now_ns() - start);
+        }
+        out += string(",{\"name\":") + (exact ? "\"hyperpath_potentials\"" : "\"hyperpath\"")
+            + "," + search.json() + ",\"reachable\":" + to_string(reachable);
+        if (exact)
+            out += ",\"potentials\":{" + potentials.json() + "}";
+        out += ",\"recover\":{" + recover.json() + "},\"stats\":" + stats_json(ws.stats) + "}";
+    }
+    return out + "]}";
+}
+
+static void usage() {
+    cerr << "usage: dhs_bench [--grid RxC]... [--geometric N]... [--dimacs FILE]...\n"
+            "                 [--network FILE]... [--queries Q] [--reps R] [--spread S]\n"
+            "                 [--seed S] [--out FILE]" << endl;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    opt.queries = 100;
+    opt.reps = 5;
+    opt.spread = 1.0;
+    opt.seed = 1;
+    string out_path;
+    // networks are made once the options are all read, the seed among them
+    vector<pair<string, string> > specs;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        string v = argv[++i];
+        if (a == "--grid" || a == "--geometric" || a == "--dimacs" || a == "--network") {
+            specs.push_back(make_pair(a, v));
+        } else if (a == "--queries") {
+            opt.queries = atoi(v.c_str());
+        } else if (a == "--reps") {
+            opt.reps = max(1, atoi(v.c_str()));
+        } else if (a == "--spread") {
+            opt.spread = float(atof(v.c_str()));
+        } else if (a == "--seed") {
+            opt.seed = strtoull(v.c_str(), nullptr, 10);
+        } else if (a == "--out") {
+            out_path = v;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (specs.empty()) {
+        specs.push_back(make_pair(string("--grid"), string("100x100")));
+        specs.push_back(make_pair(string("--geometric"), string("10000")));
+    }
+
+    string json = "{\"benchmark\":\"dhs_bench\",\"seed\":" + to_string(opt.seed)
+        + ",\"queries\":" + to_string(opt.queries) + ",\"reps\":" + to_string(opt.reps)
+        + ",\"spread\":" + to_string(opt.spread) + ",\"compiler\":" + json_quote(__VERSION__)
+        + ",\"networks\":[";
+    for (size_t k = 0; k < specs.size(); ++k) {
+        // every network has a generator of its own, adding one doesn't change the others
+        SplitMix64 rng(opt.seed + k);
+        Network net;
+        const string &v = specs[k].second;
+        if (specs[k].first == "--grid") {
+            int r = 0;
+            int c = 0;
+            if (sscanf(v.c_str(), "%dx%d", &r, &c) != 2 || r < 1 || c < 1) {
+                cerr << "bad grid size " << v << endl;
+                return 2;
+            }
+            net = make_grid(r, c, opt, rng);
+        } else if (specs[k].first == "--geometric") {
+            net = make_geometric(max(2, atoi(v.c_str())), opt, rng);
+        } else if (specs[k].first == "--dimacs") {
+            if (!read_dimacs(v, opt, rng, net)) {
+                cerr << "can't read " << v << endl;
+                return 1;
+            }
+        } else {
+            net.name = v;
+            if (!read_rows(v, net.rows)) {
+                cerr << "can't read " << v << endl;
+                return 1;
+            }
+        }
+        if (net.rows.empty()) {
+            cerr << "no edges in " << net.name << endl;
+            return 1;
+        }
+        cerr << "benchmarking " << net.name << endl;
+        json += (k ? "," : "") + bench_network(net, opt);
+    }
+    json += "]}\n";
+
+    if (out_path.empty()) {
+        cout << json;
+    } else {
+        FILE* f = fopen(out_path.c_str(), "w");
+        if (!f || fputs(json.c_str(), f) < 0) {
+            cerr << "can't write " << out_path << endl;
+            return 1;
+        }
+        fclose(f);
+    }
+    return 0;
+}
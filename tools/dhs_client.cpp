@@ -0,0 +1,167 @@
+//
+//  dhs_client.cpp
+//  MyGraph
+//
+//  Load generator for dhs_server. Every connection keeps up to --window
+//  requests in flight between random vertices of the network file, and the
+//  latency of each is taken from its send to its answer. Prints QPS and the
+//  p50/p99 latencies once --requests answers are in.
+//
+//  dhs_client --network FILE [--unix PATH | --port N] [--connections C]
+//             [--requests R] [--window W] [--op hyperpath|shortest]
+//             [--seed S]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include "protocol.h"
+
+typedef chrono::steady_clock Clock;
+
+struct Stats {
+    vector<double> latency; // microseconds
+    size_t errors;
+};
+
+// one connection sending _count requests, numbered from _first
+static void drive(const string &_unix, int _port, const vector<string> &_vertices,
+                  const string &_op, long _first, long _count, int _window,
+                  unsigned _seed, Stats &_stats) {
+    int fd = open_connection(_unix, _port);
+    if (fd < 0) {
+        _stats.errors += _count;
+        return;
+    }
+    mt19937 rng(_seed);
+    uniform_int_distribution<size_t> pick(0, _vertices.size() - 1);
+    unordered_map<long, Clock::time_point> sent;
+    LineReader reader(fd);
+    long next = 0;
+    long done = 0;
+    string line;
+    string value;
+    while (done < _count) {
+        // tops the window up in one write
+        string batch;
+        Clock::time_point now = Clock::now();
+        while (next < _count && long(sent.size()) < _window) {
+            long id = _first + next++;
+            batch += "{\"id\":" + to_string(id) + ",\"op\":\"" + _op + "\",\"o\":"
+                + json_quote(_vertices[pick(rng)]) + ",\"d\":"
+                + json_quote(_vertices[pick(rng)]) + "}\n";
+            sent[id] = now;
+        }
+        if (!batch.empty() && !write_all(fd, batch))
+            break;
+        do {
+            if (!reader.next(line))
+                goto closed;
+            Clock::time_point at = Clock::now();
+            if (!json_field(line, "id", value))
+                continue;
+            auto it = sent.find(atol(value.c_str()));
+            if (it == sent.end())
+                continue;
+            _stats.latency.push_back(chrono::duration<double, micro>(at - it->second).count());
+            if (json_field(line, "error", value))
+                _stats.errors++;
+            sent.erase(it);
+            done++;
+        } while (reader.ready());
+    }
+closed:
+    _stats.errors += _count - done;
+    close(fd);
+}
+
+static double percentile(const vector<double> &_sorted, double _q) {
+    if (_sorted.empty())
+        return 0;
+    size_t k = min(_sorted.size() - 1, size_t(_q * (_sorted.size() - 1) + 0.5));
+    return _sorted[k];
+}
+
+static int usage() {
+    cerr << "usage: dhs_client --network FILE [--unix PATH | --port N] [--connections C]"
+            " [--requests R] [--window W] [--op hyperpath|shortest] [--seed S]" << endl;
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    string network;
+    string unix_path;
+    string op = "hyperpath";
+    int port = 7700;
+    int connections = 4;
+    long requests = 10000;
+    int window = 16;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string key = argv[i];
+        if (key == "--network")
+            network = argv[i + 1];
+        else if (key == "--unix")
+            unix_path = argv[i + 1];
+        else if (key == "--port")
+            port = atoi(argv[i + 1]);
+        else if (key == "--connections")
+            connections = max(1, atoi(argv[i + 1]));
+        else if (key == "--requests")
+            requests = max(1L, atol(argv[i + 1]));
+        else if (key == "--window")
+            window = max(1, atoi(argv[i + 1]));
+        else if (key == "--op")
+            op = argv[i + 1];
+        else if (key == "--seed")
+            seed = atoi(argv[i + 1]);
+        else
+            return usage();
+    }
+    if (network.empty() || argc % 2 == 0)
+        return usage();
+
+    vector<NetworkRow> rows;
+    if (!read_rows(network, rows) || rows.empty()) {
+        cerr << "can't read a network from " << network << endl;
+        return 1;
+    }
+    set<string> ids;
+    for (const auto &row : rows) {
+        ids.insert(row.from);
+        ids.insert(row.to);
+    }
+    vector<string> vertices(ids.begin(), ids.end());
+
+    vector<Stats> stats(connections);
+    vector<thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int c = 0; c < connections; ++c) {
+        stats[c].errors = 0;
+        long first = requests * c / connections;
+        long count = requests * (c + 1) / connections - first;
+        threads.push_back(thread(drive, cref(unix_path), port, cref(vertices), cref(op),
+                                 first, count, window, seed + c, ref(stats[c])));
+    }
+    for (auto &t : threads)
+        t.join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<double> latency;
+    size_t errors = 0;
+    for (const auto &s : stats) {
+        latency.insert(latency.end(), s.latency.begin(), s.latency.end());
+        errors += s.errors;
+    }
+    sort(latency.begin(), latency.end());
+    printf("requests %zu  errors %zu  seconds %.3f  qps %.0f\n", latency.size(), errors,
+           seconds, latency.size() / seconds);
+    printf("latency us  p50 %.0f  p99 %.0f  max %.0f\n", percentile(latency, 0.5),
+           percentile(latency, 0.99), latency.empty() ? 0.0 : latency.back());
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,379 @@
+//
+//  dhs_server.cpp
+//  MyGraph
+//
+//  Standalone query server: loads a network file once and answers hyperpath
+//  and shortest path requests over a unix or TCP socket, protocol in
+//  protocol.h.
+//
+//  Every connection has a reader thread putting its request lines on one
+//  queue. Workers take up to --batch requests at a time, answer them with
+//  their own workspace and send the answers of each connection in one write,
+//  so a busy queue costs one lock and one syscall per batch rather than per
+//  request. Weights are reloaded from a file, by request or on SIGHUP, into
+//  a new snapshot swapped in atomically; running requests finish on theirs.
+//
+//  dhs_server --network FILE [--unix PATH | --port N] [--threads K]
+//             [--batch B] [--cache C]
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <pthread.h>
+#include "graph.h"
+#include "hyperpath_search.h"
+#include "potential.h"
+#include "protocol.h"
+
+struct Snapshot {
+    vector<float> wmin;
+    vector<float> wmax;
+    unsigned long version;
+};
+
+// closes the socket with the last request holding it
+struct Connection {
+    Connection(int _fd) : fd(_fd) {}
+    ~Connection() { close(fd); }
+    int fd;
+    mutex write_lock; // workers answering at once mustn't interleave
+};
+
+struct Request {
+    shared_ptr<Connection> conn;
+    string line;
+};
+
+// labels of one worker
+struct Workspace {
+    Workspace(const Topology &_t)
+        : hyperpath(_t.n, _t.m, _t.turn_cnt), u(_t.n, numeric_limits<float>::infinity()),
+          state(_t.n, 0), heap(_t.n) {}
+    HyperpathWorkspace hyperpath;
+    vector<float> u; // shortest path labels
+    vector<char> state; // 0 unreached, 1 on the heap, 2 settled
+    vector<int> touched;
+    FHeap heap;
+};
+
+// wmin distance from _o_idx to _d_idx, stopping once _d_idx is settled
+static float shortest(const Topology &_t, const float* _w, int _o_idx, int _d_idx, Workspace &_ws) {
+    for (const auto &i : _ws.touched) {
+        _ws.u[i] = numeric_limits<float>::infinity();
+        _ws.state[i] = 0;
+    }
+    _ws.touched.clear();
+    _ws.heap.clear();
+    _ws.u[_o_idx] = 0.0;
+    _ws.state[_o_idx] = 1;
+    _ws.touched.push_back(_o_idx);
+    _ws.heap.insert(_o_idx, 0.0);
+    while (_ws.heap.nItems() > 0) {
+        int i_idx = _ws.heap.deleteMin();
+        _ws.state[i_idx] = 2;
+        if (i_idx == _d_idx)
+            return _ws.u[i_idx];
+        for (int k = _t.out_offset[i_idx]; k < _t.out_offset[i_idx + 1]; ++k) {
+            int a_idx = _t.out_edge[k];
+            int j_idx = _t.head[a_idx];
+            float dist = _ws.u[i_idx] + _w[a_idx];
+            if (_ws.state[j_idx] == 2 || !(dist < _ws.u[j_idx]))
+                continue;
+            _ws.u[j_idx] = dist;
+            if (_ws.state[j_idx] == 0) {
+                _ws.state[j_idx] = 1;
+                _ws.touched.push_back(j_idx);
+                _ws.heap.insert(j_idx, dist);
+            } else {
+                _ws.heap.decreaseKey(j_idx, dist);
+            }
+        }
+    }
+    return numeric_limits<float>::infinity();
+}
+
+static string number(float _x) {
+    if (_x == numeric_limits<float>::infinity())
+        return "null";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", _x);
+    return buf;
+}
+
+class Server {
+public:
+    Server(Graph &_g, const vector<NetworkRow> &_rows, int _batch, int _cache)
+        : g(_g), t(_g.get_topology()), batch(_batch) {
+        shared_ptr<Snapshot> w = make_shared<Snapshot>();
+        w->wmin.resize(t.m);
+        w->wmax.resize(t.m);
+        for (const auto &row : _rows) {
+            int a_idx = g.get_eidx(row.id);
+            w->wmin[a_idx] = row.wmin;
+            w->wmax[a_idx] = row.wmax;
+        }
+        w->version = 0;
+        atomic_store(&weights, shared_ptr<const Snapshot>(w));
+        if (_cache > 0)
+            potentials.reset(new PotentialCache(_cache));
+    }
+
+    void submit(const shared_ptr<Connection> &_conn, const string &_line) {
+        {
+            lock_guard<mutex> guard(lock);
+            queue.push_back(Request{_conn, _line});
+        }
+        ready.notify_one();
+    }
+
+    void work() {
+        Workspace ws(t);
+        vector<Request> taken;
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [&] { return !queue.empty(); });
+                while (!queue.empty() && taken.size() < size_t(batch)) {
+                    taken.push_back(move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+            // answers grouped by connection, in request order within one
+            vector<pair<Connection*, string> > out;
+            unordered_map<Connection*, size_t> slot;
+            for (const auto &r : taken) {
+                auto it = slot.find(r.conn.get());
+                if (it == slot.end()) {
+                    it = slot.insert(make_pair(r.conn.get(), out.size())).first;
+                    out.push_back(make_pair(r.conn.get(), string()));
+                }
+                out[it->second].second += handle(r.line, ws) + "\n";
+            }
+            for (const auto &o : out) {
+                lock_guard<mutex> guard(o.first->write_lock);
+                write_all(o.first->fd, o.second);
+            }
+            taken.clear();
+        }
+    }
+
+    // weights of the edges listed in _path replace the current ones
+    bool reload(const string &_path, string &_error) {
+        vector<NetworkRow> rows;
+        if (!read_rows(_path, rows)) {
+            _error = "can't read " + _path;
+            return false;
+        }
+        lock_guard<mutex> guard(reload_lock);
+        shared_ptr<const Snapshot> old = atomic_load(&weights);
+        shared_ptr<Snapshot> w = make_shared<Snapshot>(*old);
+        try {
+            for (const auto &row : rows) {
+                int a_idx = g.get_eidx(row.id);
+                w->wmin[a_idx] = row.wmin;
+                w->wmax[a_idx] = row.wmax;
+            }
+        } catch (const string &e) {
+            _error = e;
+            return false;
+        }
+        w->version = old->version + 1;
+        atomic_store(&weights, shared_ptr<const Snapshot>(w));
+        return true;
+    }
+
+    unsigned long version() const {
+        return atomic_load(&weights)->version;
+    }
+
+private:
+    string handle(const string &_line, Workspace &_ws) {
+        string id = "null";
+        string op;
+        json_field(_line, "id", id);
+        if (!json_field(_line, "op", op))
+            op = "hyperpath";
+        string head = "{\"id\":" + json_quote_id(id);
+
+        if (op == "reload") {
+            string path;
+            string error;
+            if (!json_field(_line, "file", path))
+                return head + ",\"error\":\"reload needs a file\"}";
+            if (!reload(path, error))
+                return head + ",\"error\":" + json_quote(error) + "}";
+            return head + ",\"version\":" + to_string(version()) + "}";
+        }
+
+        string o;
+        string d;
+        if (!json_field(_line, "o", o) || !json_field(_line, "d", d))
+            return head + ",\"error\":\"o and d are needed\"}";
+        int o_idx;
+        int d_idx;
+        try {
+            o_idx = g.get_vidx(o);
+            d_idx = g.get_vidx(d);
+        } catch (const string &e) {
+            return head + ",\"error\":" + json_quote(e) + "}";
+        }
+        shared_ptr<const Snapshot> w = atomic_load(&weights);
+
+        if (op == "shortest") {
+            if (t.turn_cnt > 0)
+                return head + ",\"error\":\"turn tables aren't supported\"}";
+            return head + ",\"cost\":" + number(shortest(t, w->wmin.data(), o_idx, d_idx, _ws)) + "}";
+        }
+        if (op != "hyperpath")
+            return head + ",\"error\":\"unknown op\"}";
+
+        HyperpathWeights hw;
+        hw.wmin = w->wmin.data();
+        hw.wmax = w->wmax.data();
+        hw.h = nullptr;
+        PotentialCache::Potentials cached;
+        if (potentials) {
+            cached = potentials->get(t, hw.wmin, w->version, o_idx);
+            hw.h = cached->data();
+        }
+        HyperpathWorkspace &hs = _ws.hyperpath;
+        hyperpath_search(t, hw, o_idx, d_idx, hs);
+        string edges;
+        string probs;
+        for (const auto &a_idx : hs.po_edges) {
+            if (hs.p_a[a_idx] == 0)
+                continue;
+            if (!edges.empty()) {
+                edges += ",";
+                probs += ",";
+            }
+            edges += to_string(a_idx);
+            probs += number(hs.p_a[a_idx]);
+        }
+        return head + ",\"cost\":" + number(hs.u_i[o_idx]) + ",\"edges\":[" + edges
+            + "],\"probs\":[" + probs + "]}";
+    }
+
+    // numeric ids are echoed as numbers, anything else as a string
+    static string json_quote_id(const string &_id) {
+        if (_id.empty() || _id == "null")
+            return "null";
+        char* end = nullptr;
+        strtod(_id.c_str(), &end);
+        if (end != _id.c_str() && *end == '\0')
+            return _id;
+        return json_quote(_id);
+    }
+
+    Graph &g;
+    Topology t;
+    int batch;
+    shared_ptr<const Snapshot> weights; // only through atomic_load/atomic_store
+    mutex reload_lock;
+    unique_ptr<PotentialCache> potentials;
+    mutex lock;
+    condition_variable ready;
+    deque<Request> queue;
+};
+
+static void serve(Server &_server, int _fd) {
+    shared_ptr<Connection> conn = make_shared<Connection>(_fd);
+    LineReader reader(_fd);
+    string line;
+    while (reader.next(line)) {
+        if (!line.empty())
+            _server.submit(conn, line);
+    }
+}
+
+static int usage() {
+    cerr << "usage: dhs_server --network FILE [--unix PATH | --port N] [--threads K]"
+            " [--batch B] [--cache C]" << endl;
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    string network;
+    string unix_path;
+    int port = 7700;
+    int threads = max(1u, thread::hardware_concurrency());
+    int batch = 32;
+    int cache = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string key = argv[i];
+        if (key == "--network")
+            network = argv[i + 1];
+        else if (key == "--unix")
+            unix_path = argv[i + 1];
+        else if (key == "--port")
+            port = atoi(argv[i + 1]);
+        else if (key == "--threads")
+            threads = max(1, atoi(argv[i + 1]));
+        else if (key == "--batch")
+            batch = max(1, atoi(argv[i + 1]));
+        else if (key == "--cache")
+            cache = atoi(argv[i + 1]);
+        else
+            return usage();
+    }
+    if (network.empty() || argc % 2 == 0)
+        return usage();
+
+    vector<NetworkRow> rows;
+    if (!read_rows(network, rows) || rows.empty()) {
+        cerr << "can't read a network from " << network << endl;
+        return 1;
+    }
+    set<string> vertices;
+    for (const auto &row : rows) {
+        vertices.insert(row.from);
+        vertices.insert(row.to);
+    }
+    Graph g(vertices.size(), rows.size());
+    for (const auto &row : rows)
+        g.add_edge(row.id, row.from, row.to);
+    Server server(g, rows, batch, cache);
+
+    // SIGHUP is taken by a thread of its own, the others never see it
+    sigset_t hup;
+    sigemptyset(&hup);
+    sigaddset(&hup, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &hup, nullptr);
+    thread([&] {
+        int sig;
+        while (sigwait(&hup, &sig) == 0) {
+            string error;
+            if (server.reload(network, error))
+                cerr << "reloaded weights, version " << server.version() << endl;
+            else
+                cerr << error << endl;
+        }
+    }).detach();
+
+    for (int w = 0; w < threads; ++w)
+        thread(&Server::work, &server).detach();
+
+    int listener = open_listener(unix_path, port);
+    if (listener < 0) {
+        perror("listen");
+        return 1;
+    }
+    cerr << g.get_vertex_number() << " vertices, " << g.get_edge_number() << " edges, "
+         << threads << " workers, listening on "
+         << (unix_path.empty() ? "port " + to_string(port) : unix_path) << endl;
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        thread(serve, ref(server), fd).detach();
+    }
+}
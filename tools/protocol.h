@@ -0,0 +1,225 @@
+//
+//  protocol.h
+//  MyGraph
+//
+//  Sockets, the network file format and the line protocol shared by
+//  dhs_server and dhs_client.
+//
+//  A request or response is a flat JSON object on one line, e.g.
+//    {"id":7,"op":"hyperpath","o":"1","d":"37"}
+//    {"id":7,"cost":12.5,"edges":[3,8],"probs":[1,1]}
+//  op is hyperpath, shortest or reload (with "file"); a failed request is
+//  answered with {"id":7,"error":"..."}. Responses may come out of order,
+//  id ties them to their requests.
+//
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// value of _key in a flat JSON object, quotes removed; false if it's missing
+inline bool json_field(const string &_line, const string &_key, string &_value) {
+    const string quoted = "\"" + _key + "\"";
+    size_t k = 0;
+    // a key is followed by a colon, the same text as a value isn't
+    while ((k = _line.find(quoted, k)) != string::npos) {
+        k = _line.find_first_not_of(" \t", k + quoted.size());
+        if (k != string::npos && _line[k] == ':')
+            break;
+    }
+    if (k == string::npos)
+        return false;
+    k = _line.find_first_not_of(" \t", k + 1);
+    if (k == string::npos)
+        return false;
+    if (_line[k] == '"') {
+        size_t end = _line.find('"', k + 1);
+        if (end == string::npos)
+            return false;
+        _value = _line.substr(k + 1, end - k - 1);
+    } else {
+        size_t end = _line.find_first_of(",}", k);
+        _value = _line.substr(k, end == string::npos ? string::npos : end - k);
+        while (!_value.empty() && (_value.back() == ' ' || _value.back() == '\t'))
+            _value.pop_back();
+    }
+    return true;
+}
+
+// strings put into responses; vertex ids and messages carry no quotes or
+// control characters worth keeping
+inline string json_quote(const string &_s) {
+    string q = "\"";
+    for (const auto &c : _s) {
+        if (c != '"' && c != '\\' && (unsigned char)c >= 0x20)
+            q += c;
+    }
+    return q + "\"";
+}
+
+// one row of a network file: id, from, to, any other columns, wmin, wmax.
+// The sample network of pydhs.sample has this layout. Returns false for
+// rows whose last two columns aren't numbers, e.g. a header.
+struct NetworkRow {
+    string id;
+    string from;
+    string to;
+    float wmin;
+    float wmax;
+};
+
+inline bool parse_row(const string &_line, NetworkRow &_row) {
+    vector<string> cols;
+    stringstream ss(_line);
+    string col;
+    while (getline(ss, col, ','))
+        cols.push_back(col);
+    if (cols.size() < 5)
+        return false;
+    char* end = nullptr;
+    _row.wmin = strtof(cols[cols.size() - 2].c_str(), &end);
+    if (end == cols[cols.size() - 2].c_str())
+        return false;
+    _row.wmax = strtof(cols.back().c_str(), &end);
+    if (end == cols.back().c_str())
+        return false;
+    _row.id = cols[0];
+    _row.from = cols[1];
+    _row.to = cols[2];
+    return true;
+}
+
+inline bool read_rows(const string &_path, vector<NetworkRow> &_rows) {
+    ifstream in(_path.c_str());
+    if (!in)
+        return false;
+    string line;
+    NetworkRow row;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (parse_row(line, row))
+            _rows.push_back(row);
+    }
+    return true;
+}
+
+// a listening socket on a unix path when _unix is set, else on the TCP port
+// of the loopback interface; -1 on failure
+inline int open_listener(const string &_unix, int _port) {
+    int fd;
+    if (!_unix.empty()) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, _unix.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(_unix.c_str());
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+            return -1;
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+            return -1;
+    }
+    if (listen(fd, 128) != 0)
+        return -1;
+    return fd;
+}
+
+inline int open_connection(const string &_unix, int _port) {
+    int fd;
+    int rc;
+    if (!_unix.empty()) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, _unix.c_str(), sizeof(addr.sun_path) - 1);
+        rc = connect(fd, (sockaddr*)&addr, sizeof(addr));
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        rc = connect(fd, (sockaddr*)&addr, sizeof(addr));
+    }
+    if (fd >= 0 && rc != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline bool write_all(int _fd, const string &_data) {
+    size_t done = 0;
+    while (done < _data.size()) {
+        ssize_t k = send(_fd, _data.data() + done, _data.size() - done, MSG_NOSIGNAL);
+        if (k <= 0)
+            return false;
+        done += k;
+    }
+    return true;
+}
+
+// splits what arrives on a socket into lines
+class LineReader {
+public:
+    LineReader(int _fd) : fd(_fd), begin(0) {}
+
+    // false once the peer has closed the connection
+    bool next(string &_line) {
+        while (true) {
+            size_t k = buffer.find('\n', begin);
+            if (k != string::npos) {
+                _line.assign(buffer, begin, k - begin);
+                begin = k + 1;
+                return true;
+            }
+            buffer.erase(0, begin);
+            begin = 0;
+            char chunk[65536];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return false;
+            buffer.append(chunk, n);
+        }
+    }
+
+    // true when a line can be had without waiting
+    bool ready() const {
+        return buffer.find('\n', begin) != string::npos;
+    }
+
+private:
+    int fd;
+    string buffer;
+    size_t begin;
+};
+
+#endif /* PROTOCOL_H */